@@ -3,123 +3,17 @@
 #include <iostream>
 #include <string>
 #include <random>
+#include <span>
+#include <algorithm>
+#include <atomic>
 #include "SignalGeneratorImgui.h"
-#include "binary_file.hpp"
+#include "save_signal.hpp"
+#include "async_writer.hpp"
+#include "signal.hpp"
+#include "acquisition_engine.hpp"
 #include <chrono>
 #include <thread>
 
-
-# define M_PI           3.14159265358979323846  /* pi */
-
-class signal {
-public:
-    virtual ~signal() = default;  // Virtual destructor for polymorphism
-    virtual double out(double x) { return 0; }
-};
-
-class sin_signal : public signal {
-public:
-    sin_signal(float frequency, float phase, float amplitude)
-        : signal() {  // Initialize base class first
-        this->frequency = frequency;
-        this->phase = phase;
-        this->amplitude = amplitude;
-
-        this->start = std::chrono::steady_clock::now();
-    }
-    double frequency;
-    float phase;
-    double amplitude;
-    float increase_over_time_ratio = 0;
-    std::chrono::time_point<std::chrono::steady_clock> start;
-    double out(double x) override {
-        double y;
-        std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
-        std::chrono::duration<double> elapsed_seconds = end - start;
-        y = (amplitude+ double(increase_over_time_ratio*float(elapsed_seconds.count()))/double(60.0)) * sin(2 * M_PI * frequency * x + phase);
-        //y = double(increase_over_time_ratio * float(elapsed_seconds.count())) / double(60.0);
-        return y;
-    }
-};
-
-class pulse_train : public signal {
-public:
-    pulse_train(float frequency, float duty_cycle, float amplitude)
-        : signal() {
-        this->frequency = frequency;
-        this->duty_cycle = duty_cycle;
-        this->amplitude = amplitude;
-    }
-
-    double frequency;
-    float duty_cycle;  // Percentage of the period where the pulse is high (0 to 1)
-    double amplitude;
-
-    double out(double x) override {
-        double period = 1.0 / frequency;
-        double time_in_period = fmod(x, period);
-        return (time_in_period < duty_cycle* period) ? amplitude : 0.0;
-    }
-};
-
-class white_signal : public signal {
-private:
-    std::mt19937 gen;  // Mersenne Twister RNG
-    std::uniform_real_distribution<double> dist; // White noise distribution
-    
-public:
-    double amplitude;
-
-    // Constructor that accepts a seed for reproducibility
-    white_signal(float amplitude, unsigned int seed = std::random_device{}())
-        : gen(seed), dist(-1.0, 1.0), amplitude(amplitude) {}
-
-    double out(double x) override {
-        double y;
-        y = amplitude*dist(gen);
-        return y;
-
-    }
-    void reset() {
-        std::mt19937 newgen(1);
-        gen = newgen;
-    }
-};
-
-void GenerateSignal(const std::vector<double>& x, std::vector<double>& y, const std::unique_ptr<signal>& sin_sig) {
-    for (int i = 0; i < x.size(); i++) {
-        y[i] = sin_sig->out(x[i]);
-    }
-}
-void GenerateAddedSignal(const std::vector<double>& x, std::vector<double>& y, std::vector<std::unique_ptr<signal>>& signals) {
-    for (int i = 0; i < x.size(); i++) {
-        y[i] = 0;
-        for (size_t j = 0; j < signals.size(); j++)
-        {
-            y[i] = y[i] + signals[j]->out(x[i]);
-        }
-    }
-}
-void save_signal(std::vector<double> y, int sampling_freq, int acq_duration, int acq_interval, int channel_num, int sensor_type, int daq_serial_number, std::string address) {
-    //std::string address = "../../Data";
-    ACQCONFIG config;
-    config.daq_serial_number = daq_serial_number;
-    config.acq_interval = acq_interval;
-    config.acq_duration = acq_duration;
-    config.sampling_freq = sampling_freq;
-
-    config.parse_status  = 0;
-    config.start_channel = channel_num;
-    config.channel_count = 1;
-
-    config.channels[channel_num].status = 1;
-    config.channels[channel_num].sensitivity = 1;
-    config.channels[channel_num].sensor_type = sensor_type;
-    BinaryFile binaryFile(address, config, channel_num);
-    binaryFile.insertData(y);
-    binaryFile.close();
-}
-
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
     bool isDarkMode = false; // Default: Dark Mode
@@ -134,14 +28,24 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
     std::string data_folder_address;
 
-    int samples;
-    std::vector<double> x, y;
     std::vector<std::unique_ptr<signal>> signals;
+    // Generation runs on the engine's thread and files are written on the writer's, so neither a slow disk nor
+    // this loop holds up the acquisition cadence. The mixer keeps its sum for the preview, so a save copies it
+    // into a pooled buffer that moves to the writer; declared first, the writer outlives the engine.
+    async_writer writer;
+    acquisition_engine engine([&writer](const acquisition_settings& s, const std::vector<double>& y) {
+        write_job job;
+        job.folder = s.data_folder;
+        job.config = single_channel_config(s.sampling_freq, int(s.duration), s.interval, s.channel, s.sensor_type, s.daq_serial);
+        job.channel = s.channel;
+        job.acquired = time(0);
+        job.samples = writer.acquire(y.size());
+        std::copy(y.begin(), y.end(), job.samples.begin());
+        writer.submit(std::move(job));
+    });
 
     #include "imgui_init.h"
 
-    auto start = std::chrono::steady_clock::now();
-
     // Main loop
     bool done = false;
     while (!done)
@@ -222,13 +126,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
         ImGui::TableSetColumnIndex(1);
         if (ImGui::Button("Reset Transition")) {
-            for (size_t i = 0; i < signals.size(); i++) {
-                if (dynamic_cast<const sin_signal*>(signals[i].get())) {
-                    sin_signal* sin_sig = dynamic_cast<sin_signal*>(signals[i].get());
-                    sin_sig->start = std::chrono::steady_clock::now();
-                }
-            }
+            engine.reset_clock();
         }
+        ImGui::TableSetColumnIndex(2);
+        const lateness_histogram save_lateness = engine.save_lateness();
+        ImGui::Text("Save lateness p99 <= %.0f us, max %.0f us, %llu skipped", save_lateness.quantile_us(0.99),
+            save_lateness.max_us, (unsigned long long)engine.skipped_saves());
+        const async_writer::statistics writes = writer.stats();
+        ImGui::Text("Write queue %zu (max %zu), %llu stalls, %llu dropped, %llu failed", writes.depth, writes.max_depth,
+            (unsigned long long)writes.stalls, (unsigned long long)writes.dropped, (unsigned long long)writes.failed);
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
 
@@ -239,7 +145,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         //ImGui::SameLine();
         //ImGui::TableSetColumnIndex(7);
         if (ImGui::Button("Save Immediately")) {
-            save_signal(y, samplingFreq, sampleDuration, sampling_interval, channel_num, sensor_type, daq_serial_num, data_folder_address);
+            engine.save_now();
         }
         ImGui::TableSetColumnIndex(1);
         if (ImGui::Button(is_periodicaly ? "Stop Saving Periodically" : "Start Saving Periodically")) {
@@ -261,13 +167,6 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         ImGui::EndChild();
         ImGui::NewLine();
 
-        samples = int(samplingFreq * sampleDuration);
-        x.resize(samples);
-        y.resize(samples);
-        for (int i = 0; i < samples; i++) {
-            x[i] = i / double(samplingFreq);
-        }
-
         if (ImGui::Button("+ Add Sine Wave")) {
             signals.push_back(std::make_unique<sin_signal>(1.0, 0.0, 0.5));
         }
@@ -279,6 +178,20 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         if (ImGui::Button("+ Add Tachometer wave")) {
             signals.push_back(std::make_unique<pulse_train>(1.0, 0.05, 0.5));
         }
+        acquisition_settings settings;
+        settings.sampling_freq = samplingFreq;
+        settings.duration = sampleDuration;
+        settings.interval = sampling_interval;
+        settings.sensor_type = sensor_type;
+        settings.channel = channel_num;
+        settings.daq_serial = daq_serial_num;
+        settings.data_folder = data_folder_address;
+        settings.periodic = is_periodicaly;
+        engine.publish(settings, signals);
+        // Drawn from the engine's latest snapshot, so a panel stays empty until its signal has been generated.
+        // No time array: samples are plotted against first/fs + i/fs via ImPlot's xscale/xstart
+        std::shared_ptr<const acquisition_preview> preview = engine.preview();
+        const sample_block& block = preview->block;
         ImGui::BeginChild("sigPanelContainer", ImVec2(0, 320), ImGuiChildFlags_Borders, window_flags);
         for (size_t i = 0; i < signals.size(); i++) {
             ImGui::PushID(i);  // Ensures uniqueness
@@ -293,17 +206,21 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 ImGui::PushItemWidth(200);
                 ImGui::Text("Sine Wave");
                 ImGui::NewLine();
-                ImGui::InputDouble("Frequency", &sin_sig->frequency, 0.1f, 10.0f, "%.3f");
+                if (ImGui::InputDouble("Frequency", &sin_sig->frequency, 0.1f, 10.0f, "%.3f")) {
+                    sin_sig->touch();
+                }
                 //ImGui::Spacing();
-                ImGui::InputDouble("Amplitude", &sin_sig->amplitude, 0.1f, 10.0f, "%.3f");
+                if (ImGui::InputDouble("Amplitude", &sin_sig->amplitude, 0.1f, 10.0f, "%.3f")) {
+                    sin_sig->touch();
+                }
                 ImGui::PopItemWidth();
 
                 if (ImGuiKnobs::Knob("Phase", &sin_sig->phase, -2.0f, 2.0f, 0.1f, "%.1fpi", ImGuiKnobVariant_Tick)) {
-                    // value was changed
+                    sin_sig->touch();
                 }
                 ImGui::SameLine();
                 if (ImGuiKnobs::Knob("Increase", &sin_sig->increase_over_time_ratio, -10.0f, 10.0f, 0.2f, "%.1f", ImGuiKnobVariant_Tick)) {
-                    // value was changed
+                    sin_sig->touch();
                 }
                 ImGui::SameLine();
 
@@ -330,12 +247,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
                 ImGui::SameLine();
 
-                GenerateSignal(x, y, signals[i]);
                 ImGui::SameLine();
                 float width = ImGui::GetContentRegionAvail().x;  // Available width
                 float height = ImGui::GetContentRegionAvail().y; // Available height
                 if (ImPlot::BeginPlot("Sine Waves", ImVec2(width, 240))) {
-                    ImPlot::PlotLine(("Signal " + std::to_string(i)).c_str(), x.data(), y.data(), x.size());
+                    if (const std::vector<double>* y = preview->find(signals[i]->version())) {
+                        ImPlot::PlotLine(("Signal " + std::to_string(i)).c_str(), y->data(), int(y->size()), 1.0 / block.sampling_freq, block.time(0));
+                    }
                     ImPlot::EndPlot();
                 }
             }
@@ -348,7 +266,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 ImGui::NewLine();
                 //ImGui::InputFloat("Frequency", &white_sig->frequency, 0.1f, 10.0f, "%.3f");
                 ////ImGui::Spacing();
-                ImGui::InputDouble("Amplitude", &white_sig->amplitude, 0.05f, 10.0f, "%.3f");
+                if (ImGui::InputDouble("Amplitude", &white_sig->amplitude, 0.05f, 10.0f, "%.3f")) {
+                    white_sig->touch();
+                }
+                if (ImGui::InputScalar("Seed", ImGuiDataType_U32, &white_sig->seed)) {
+                    white_sig->touch();
+                }
                 ImGui::PopItemWidth();
 
                 if (ImGui::Button("Delete")) {
@@ -384,12 +307,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
                 //white_sig->reset();
 
-                GenerateSignal(x, y, signals[i]);
                 ImGui::SameLine();
                 float width = ImGui::GetContentRegionAvail().x;  // Available width
                 float height = ImGui::GetContentRegionAvail().y; // Available height
                 if (ImPlot::BeginPlot("White Noise", ImVec2(width, 240))) {
-                    ImPlot::PlotLine(("Signal " + std::to_string(i)).c_str(), x.data(), y.data(), x.size());
+                    if (const std::vector<double>* y = preview->find(signals[i]->version())) {
+                        ImPlot::PlotLine(("Signal " + std::to_string(i)).c_str(), y->data(), int(y->size()), 1.0 / block.sampling_freq, block.time(0));
+                    }
                     ImPlot::EndPlot();
                 }
             }
@@ -400,13 +324,17 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 ImGui::PushItemWidth(200);
                 ImGui::Text("Sine Wave");
                 ImGui::NewLine();
-                ImGui::InputDouble("Frequency", &pulse_train_sig->frequency, 0.1f, 10.0f, "%.3f");
+                if (ImGui::InputDouble("Frequency", &pulse_train_sig->frequency, 0.1f, 10.0f, "%.3f")) {
+                    pulse_train_sig->touch();
+                }
                 //ImGui::Spacing();
-                ImGui::InputDouble("Amplitude", &pulse_train_sig->amplitude, 0.1f, 10.0f, "%.3f");
+                if (ImGui::InputDouble("Amplitude", &pulse_train_sig->amplitude, 0.1f, 10.0f, "%.3f")) {
+                    pulse_train_sig->touch();
+                }
                 ImGui::PopItemWidth();
 
                 if (ImGuiKnobs::Knob("Duty Cycle", &pulse_train_sig->duty_cycle, -2.0f, 2.0f, 0.1f, "%.1fpi", ImGuiKnobVariant_Tick)) {
-                    // value was changed
+                    pulse_train_sig->touch();
                 }
                 ImGui::SameLine();
 
@@ -432,12 +360,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 ImGui::EndChild();
 
                 ImGui::SameLine();
-                GenerateSignal(x, y, signals[i]);
                 ImGui::SameLine();
                 float width = ImGui::GetContentRegionAvail().x;  // Available width
                 float height = ImGui::GetContentRegionAvail().y; // Available height
                 if (ImPlot::BeginPlot("Sine Waves", ImVec2(width, 240))) {
-                    ImPlot::PlotLine(("Signal " + std::to_string(i)).c_str(), x.data(), y.data(), x.size());
+                    if (const std::vector<double>* y = preview->find(signals[i]->version())) {
+                        ImPlot::PlotLine(("Signal " + std::to_string(i)).c_str(), y->data(), int(y->size()), 1.0 / block.sampling_freq, block.time(0));
+                    }
                     ImPlot::EndPlot();
                 }
             }
@@ -452,21 +381,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
         ImGui::PopStyleVar();
 
-        GenerateAddedSignal(x, y, signals);
-
         if (ImPlot::BeginPlot("Sine Waves")) {
-            ImPlot::PlotLine("Sum of Signals", x.data(), y.data(), x.size());
+            ImPlot::PlotLine("Sum of Signals", preview->sum.data(), int(preview->sum.size()), 1.0 / block.sampling_freq, block.time(0));
             ImPlot::EndPlot();
         }
         ImGui::End();
 
         #include "imgui_while_ending.h"
-
-        if ((is_periodicaly == 1)&&(std::chrono::steady_clock::now() - start) > std::chrono::milliseconds(sampling_interval * 1000))
-        {
-            start = std::chrono::steady_clock::now();
-            save_signal(y, samplingFreq, sampleDuration, sampling_interval, channel_num, sensor_type, daq_serial_num, data_folder_address);
-        }
     }
 
 
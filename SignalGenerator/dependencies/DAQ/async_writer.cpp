@@ -0,0 +1,143 @@
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include "async_writer.hpp"
+#include "binary_file.hpp"
+
+async_writer::async_writer()
+    : async_writer(options()) {
+}
+
+async_writer::async_writer(const options& opts)
+    : opts(opts) {
+    this->opts.queue_depth = std::max<size_t>(1, opts.queue_depth);
+    this->opts.writers = std::max<size_t>(1, opts.writers);
+    for (size_t i = 0; i < this->opts.writers; i++) {
+        threads.emplace_back([this] { run(); });
+    }
+}
+
+async_writer::~async_writer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+std::vector<double> async_writer::acquire(size_t samples) {
+    std::vector<double> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!spare.empty()) {
+            buffer = std::move(spare.back());
+            spare.pop_back();
+        }
+        if (buffer.capacity() < samples) {
+            totals.allocations++;
+        }
+    }
+    buffer.resize(samples);
+    return buffer;
+}
+
+void async_writer::release(std::vector<double>&& buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    recycle(std::move(buffer));
+}
+
+// Called with the mutex held. Keeps enough buffers for a full queue plus one per writer; more than that
+// only happens while producers outnumber the pipeline, and those are freed.
+void async_writer::recycle(std::vector<double>&& buffer) {
+    if (spare.size() < opts.queue_depth + opts.writers) {
+        spare.push_back(std::move(buffer));
+    }
+}
+
+bool async_writer::submit(write_job&& job) {
+    std::unique_lock<std::mutex> lock(mutex);
+    totals.submitted++;
+    if (queue.size() >= opts.queue_depth) {
+        if (opts.drop_when_full) {
+            totals.dropped++;
+            recycle(std::move(job.samples));
+            lock.unlock();
+            if (job.done) {
+                job.done(false);
+            }
+            return false;
+        }
+        totals.stalls++;
+        const auto start = std::chrono::steady_clock::now();
+        room.wait(lock, [this] { return queue.size() < opts.queue_depth; });
+        totals.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    queue.push_back(std::move(job));
+    totals.max_depth = std::max(totals.max_depth, queue.size());
+    lock.unlock();
+    queued.notify_one();
+    return true;
+}
+
+void async_writer::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [this] { return queue.empty() && in_flight == 0; });
+}
+
+async_writer::statistics async_writer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    statistics s = totals;
+    s.depth = queue.size();
+    return s;
+}
+
+void async_writer::run() {
+    std::unique_ptr<thread_pool> compressors;
+    if (opts.file.compress && opts.compress_threads > 1) {
+        compressors = std::make_unique<thread_pool>(opts.compress_threads);
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;  // stopping, and everything queued is written
+        }
+        write_job job = std::move(queue.front());
+        queue.pop_front();
+        in_flight++;
+        lock.unlock();
+        room.notify_one();
+
+        const auto start = std::chrono::steady_clock::now();
+        uint64_t bytes = 0;
+        bool ok;
+        {
+            BinaryFile file = job.channel < 0 ? BinaryFile(job.folder, job.config, opts.file, job.acquired)
+                : BinaryFile(job.folder, job.config, job.channel, opts.file, job.acquired);
+            ok = file.writeAll(job.samples, compressors.get()) == 0;
+            bytes = file.bytesWritten();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (job.done) {
+            job.done(ok);
+        }
+
+        lock.lock();
+        totals.write_seconds += seconds;
+        if (ok) {
+            totals.written++;
+            totals.bytes += bytes;
+        }
+        else {
+            totals.failed++;
+        }
+        recycle(std::move(job.samples));
+        in_flight--;
+        if (queue.empty() && in_flight == 0) {
+            drained.notify_all();
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include <ctime>
+#include "ACQConfig.hpp"
+#include "file_backend.hpp"
+
+// One acquisition of one channel, ready to be written. The job owns its samples.
+struct write_job {
+    std::string folder;
+    ACQCONFIG config;
+    int channel = 0;                // -1: every enabled channel of config, planar in samples, in one version 4 file
+    time_t acquired = 0;            // names the file; 0 is whenever a writer gets to the job, which a backlog can
+                                    // make the same second for two jobs
+    std::vector<double> samples;
+    // Called once the file is written (true) or the job was failed or dropped (false), on the writer thread,
+    // or on the submitting thread for a drop
+    std::function<void(bool)> done;
+};
+
+// Writes acquisitions to disk on writer threads of its own, so the thread that generated them goes straight
+// on to the next one. Buffers circulate: the generator takes one from acquire(), fills it and moves it into
+// submit(); once written it goes back to the pool for the next acquire(). The queue between them is bounded:
+// when it is full, submit() either waits for a slot (a stall) or drops the acquisition, so a disk that
+// cannot keep up shows up in the statistics instead of as unbounded memory.
+class async_writer {
+public:
+    struct options {
+        size_t queue_depth = 4;       // jobs waiting for a writer; 2 with one writer is classic double buffering
+        size_t writers = 1;
+        bool drop_when_full = false;  // false stalls the caller of submit() until there is room
+        size_t compress_threads = 1;  // with file.compress, threads compressing the chunks of each file, the writer
+                                      // included; every writer gets a thread_pool of this many
+        file_options file;
+    };
+    struct statistics {
+        uint64_t submitted = 0;
+        uint64_t written = 0;
+        uint64_t failed = 0;
+        uint64_t dropped = 0;         // queue full with drop_when_full
+        uint64_t stalls = 0;          // submit() calls that had to wait for room
+        double stall_seconds = 0;
+        double write_seconds = 0;     // summed over writers
+        uint64_t bytes = 0;           // of the files written, as stored
+        uint64_t allocations = 0;     // acquire() calls the pool could not serve
+        size_t depth = 0;             // jobs queued right now
+        size_t max_depth = 0;
+    };
+
+    async_writer();
+    explicit async_writer(const options& opts);
+    // Writes everything still queued before returning
+    ~async_writer();
+    async_writer(const async_writer&) = delete;
+    async_writer& operator=(const async_writer&) = delete;
+
+    // A buffer of this many samples, reused from a written job when one is spare. Contents are unspecified.
+    std::vector<double> acquire(size_t samples);
+    // Hands a buffer back without writing it
+    void release(std::vector<double>&& buffer);
+    // Takes ownership of the job; false if it was dropped because the queue was full
+    bool submit(write_job&& job);
+    // Blocks until every submitted job has been written and its done callback has returned
+    void flush();
+    statistics stats() const;
+
+private:
+    void run();
+    void recycle(std::vector<double>&& buffer);
+
+    options opts;
+    mutable std::mutex mutex;
+    std::condition_variable queued;   // writers wait for jobs
+    std::condition_variable room;     // submitters wait for a free slot
+    std::condition_variable drained;  // flush() waits for the queue and the writers to empty
+    std::deque<write_job> queue;
+    std::vector<std::vector<double>> spare;
+    size_t in_flight = 0;
+    bool stopping = false;
+    statistics totals;
+    std::vector<std::thread> threads;
+};
@@ -1,32 +1,68 @@
 #define _CRT_SECURE_NO_WARNINGS
-#include <fstream>
+#include <cstring>
 //#include <sstream>
 //#include <iomanip>
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 #include "binary_file.hpp"
+#include "crc32c.hpp"
+#include "file_publish.hpp"
+#include "sample_codec.hpp"
+#include "sample_encoding.hpp"
 #include "utils.hpp"
 #include "ACQConfig.hpp"
 
 const int version = 3;
+const int multi_channel_version = 4;
 const std::string extention_org = ".bin";
 const std::string extention_temp = ".temp";
+// Samples per channel in each chunk of a compressed file that does not say
+const int compressed_chunk_frames = 16384;
 
-BinaryFile::BinaryFile(const std::string& localDataFolder, ACQCONFIG& config, int channel_num) {
-    filename_wihout_extension = getCurrentDateTimeJustDash() + "_" + std::to_string(channel_num);
-    filename_org = filename_wihout_extension + extention_org;
-    filename_temp = filename_wihout_extension + extention_temp;
-    file_name_location = localDataFolder + ("/" + filename_org);
+namespace {
+
+// Process and file number, so no two writers ever share a .temp file, even two writing files of the same final name
+std::string temp_suffix() {
+    static std::atomic<unsigned long long> files{ 0 };
+#ifdef _WIN32
+    const int pid = _getpid();
+#else
+    const int pid = int(getpid());
+#endif
+    return "." + std::to_string(pid) + "-" + std::to_string(files++);
+}
+
+}  // namespace
 
-    OutputFile.open(file_name_location, std::ios::binary | std::ios::trunc | std::ios::out);
-    if (!OutputFile.is_open()) {
-        std::cout << "Error initializing binary file! file cannot be opened!" << std::endl;
+BinaryFile::BinaryFile(const std::string& localDataFolder, ACQCONFIG& config, int channel_num, const file_options& options, time_t acquired)
+    : options(options) {
+    if (acquired == 0) {
+        acquired = time(0);
     }
+    filename_wihout_extension = formatDateTimeJustDash(acquired) + "_" + std::to_string(channel_num);
+    filename_org = filename_wihout_extension + extention_org;
+    filename_temp = filename_wihout_extension + temp_suffix() + extention_temp;
+    file_name_location = localDataFolder + ("/" + filename_org);
+    temp_name_location = localDataFolder + ("/" + filename_temp);
     dataRecordCount = 0;
+    trailer.recordCount = 0;
+    format_version = options.version >= multi_channel_version ? multi_channel_version : version;
+    if (format_version == multi_channel_version) {
+        initHeaderV4(config, &channel_num, 1, acquired);
+        return;
+    }
 
     // Set the file signature
-    strncpy(header.signature, "PDAT", 4);
+    memcpy(header.signature, "PDAT", 4);
     // Set the version number
     header.version = version;
     header.serial_num = config.daq_serial_number;
@@ -34,59 +70,459 @@ BinaryFile::BinaryFile(const std::string& localDataFolder, ACQCONFIG& config, in
     header.sensor_type = config.channels[channel_num].sensor_type;
     header.sensitivity = config.channels[channel_num].sensitivity;
     header.channel_num = channel_num;
-    // Set the current date and time
-    strncpy(header.date, getCurrentDateTime().c_str(), 20);
+    // Set the date and time of the acquisition
+    strncpy(header.date, formatDateTime(acquired).c_str(), sizeof(header.date) - 1);
+    header.date[sizeof(header.date) - 1] = '\0';
+    header.encoding = int(options.encoding);
+    header.scale = float(encoding_scale(options.encoding, options.full_scale, header.sensitivity));
+    inverse_scale[0] = 1.0 / double(header.scale);
     // Reserve future space with zeros
     memset(header.reserved, 0, sizeof(header.reserved));
-    // Write the header to the binary file
-    OutputFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
 
-    if (OutputFile.fail()) {
-        std::cout << "Error writing header to the file: " << file_name_location << std::endl;
+BinaryFile::BinaryFile(const std::string& localDataFolder, ACQCONFIG& config, const file_options& options, time_t acquired)
+    : options(options) {
+    if (acquired == 0) {
+        acquired = time(0);
     }
-    else {
-        std::cout << "Open binary file: " << file_name_location << " successfully" << std::endl;
+    filename_wihout_extension = formatDateTimeJustDash(acquired);
+    filename_org = filename_wihout_extension + extention_org;
+    filename_temp = filename_wihout_extension + temp_suffix() + extention_temp;
+    file_name_location = localDataFolder + ("/" + filename_org);
+    temp_name_location = localDataFolder + ("/" + filename_temp);
+    dataRecordCount = 0;
+    trailer.recordCount = 0;
+    format_version = multi_channel_version;
+    int channels[4];
+    int count = 0;
+    for (int c = 0; c < 4; c++) {
+        if (config.channels[c].status == 1) {
+            channels[count++] = c;
+        }
     }
+    initHeaderV4(config, channels, count, acquired);
 }
-int BinaryFile::insertData(std::vector<double>& Data){
-    if (!OutputFile.is_open()) {
-        std::cout << "Error insert to binary file! file cannot be opened!" << std::endl;
-        return 1;
+
+void BinaryFile::initHeaderV4(ACQCONFIG& config, const int* channels, int count, time_t acquired) {
+    memset(&header, 0, sizeof(header));
+    memset(&header_v4, 0, sizeof(header_v4));
+    memcpy(header_v4.signature, "PDAT", 4);
+    header_v4.version = multi_channel_version;
+    header_v4.serial_num = config.daq_serial_number;
+    header_v4.smpl_freq = config.sampling_freq;
+    header_v4.channel_count = count;
+    header_v4.layout = int(options.layout);
+    header_v4.acq_duration = config.acq_duration;
+    header_v4.acq_interval = config.acq_interval;
+    strncpy(header_v4.date, formatDateTime(acquired).c_str(), sizeof(header_v4.date) - 1);
+    header_v4.chunk_frames = int(options.chunk_frames);
+    header_v4.encoding = int(options.encoding);
+    if (options.compress) {
+        // Compression works chunk by chunk
+        if (header_v4.chunk_frames == 0) {
+            header_v4.chunk_frames = compressed_chunk_frames;
+        }
+        header_v4.codec = int(codec_for(options.encoding));
+    }
+    for (int i = 0; i < count; i++) {
+        ChannelEntry& entry = header_v4.channels[i];
+        entry.channel_num = channels[i];
+        entry.sensor_type = config.channels[channels[i]].sensor_type;
+        entry.sensitivity = config.channels[channels[i]].sensitivity;
+        entry.scale = float(encoding_scale(options.encoding, options.full_scale, entry.sensitivity));
+        // From the scale as stored, so a reader gets back exactly the counts written
+        inverse_scale[i] = 1.0 / double(entry.scale);
+    }
+}
+
+write_segment BinaryFile::headerSegment() const {
+    if (format_version == multi_channel_version) {
+        return { &header_v4, sizeof(header_v4) };
+    }
+    return { &header, sizeof(header) };
+}
+
+bool BinaryFile::open(uint64_t expected_size) {
+    if (opened) {
+        return output != nullptr;
+    }
+    opened = true;
+    // Publishing would fail anyway; better before writing the whole file
+    std::error_code ec;
+    if (std::filesystem::exists(file_name_location, ec)) {
+        std::cerr << "Error initializing binary file " << file_name_location << ": a file of that name exists already!\n";
+        return false;
+    }
+    output = make_file_backend(options);
+    if (!output->open(temp_name_location, expected_size)) {
+        std::cerr << "Error initializing binary file " << temp_name_location << ": file cannot be opened!\n";
+        output.reset();
+        return false;
+    }
+    return true;
+}
+
+bool BinaryFile::writeOut(const write_segment* segments, size_t count) {
+    if (!output->write(segments, count)) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        bytes_written += segments[i].size;
+    }
+    return true;
+}
+
+bool BinaryFile::finish(bool written) {
+    const bool closed = output->close();
+    if (written && closed && publish_file(temp_name_location, file_name_location, options.fsync)) {
+        return true;
+    }
+    // Never published; whatever made it to disk is of no use
+    std::error_code ec;
+    std::filesystem::remove(temp_name_location, ec);
+    return false;
+}
+
+bool BinaryFile::chunked() const {
+    return format_version == multi_channel_version && header_v4.chunk_frames > 0;
+}
+
+bool BinaryFile::compressed() const {
+    return chunked() && header_v4.codec != int(sample_codec::none);
+}
+
+sample_encoding BinaryFile::encoding() const {
+    return options.encoding;
+}
+
+write_segment BinaryFile::encodeValues(const double* values, size_t count, double inverse) {
+    if (encoding() == sample_encoding::float64) {
+        return { values, count * sizeof(double) };
+    }
+    encoded.resize(count * encoded_size(encoding()));
+    encode_samples(encoding(), values, count, inverse, encoded.data());
+    return { encoded.data(), encoded.size() };
+}
+
+write_segment BinaryFile::compressChunk(const double* const* sources, size_t stride, size_t frames, const double* inverse, chunk_buffers& buffers) const {
+    const size_t channels = size_t(channelCount());
+    std::vector<unsigned char>& packed = buffers.packed;
+    packed.assign(channels * sizeof(uint32_t), 0);
+    for (size_t c = 0; c < channels; c++) {
+        const double* values = sources[c];
+        if (stride != 1) {
+            buffers.gathered.resize(frames);
+            for (size_t i = 0; i < frames; i++) {
+                buffers.gathered[i] = values[i * stride];
+            }
+            values = buffers.gathered.data();
+        }
+        const void* samples = values;
+        if (encoding() != sample_encoding::float64) {
+            buffers.encoded.resize(frames * encoded_size(encoding()));
+            encode_samples(encoding(), values, frames, inverse[c], buffers.encoded.data());
+            samples = buffers.encoded.data();
+        }
+        const size_t start = packed.size();
+        compress_samples(encoding(), samples, frames, packed);
+        const uint32_t size = uint32_t(packed.size() - start);
+        memcpy(packed.data() + c * sizeof(uint32_t), &size, sizeof(size));
+    }
+    return { packed.data(), packed.size() };
+}
+
+write_segment BinaryFile::insertedChunk(const double* values, size_t frames) {
+    const size_t channels = size_t(std::max(1, channelCount()));
+    const double inverse = insertInverseScale();
+    if (!compressed()) {
+        return encodeValues(values, frames * channels, inverse);
+    }
+    // Interleaved integer values come scaled per channel already, and insertInverseScale() is 1 for them
+    const double inverses[4] = { inverse, inverse, inverse, inverse };
+    const bool interleaved = options.layout == sample_layout::interleaved;
+    const double* sources[4];
+    for (size_t c = 0; c < channels; c++) {
+        sources[c] = interleaved ? values + c : values + c * frames;
+    }
+    return compressChunk(sources, interleaved ? channels : 1, frames, inverses, compression);
+}
+
+double BinaryFile::insertInverseScale() const {
+    return channelCount() > 1 ? 1.0 : inverse_scale[0];
+}
+
+void BinaryFile::addToChunk(const write_segment* segments, size_t count) {
+    if (!chunked()) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        chunk_crc = crc32c(chunk_crc, segments[i].data, segments[i].size);
+        payload_bytes += segments[i].size;
+    }
+}
+
+void BinaryFile::endChunk(size_t frames) {
+    if (!chunked() || frames == 0) {
+        return;
+    }
+    ChunkEntry entry;
+    entry.offset = headerSegment().size + chunk_start;
+    entry.bytes = uint32_t(payload_bytes - chunk_start);
+    entry.frames = uint32_t(frames);
+    entry.crc = chunk_crc;
+    entry.reserved = 0;
+    chunks.push_back(entry);
+    chunk_start = payload_bytes;
+    chunk_crc = 0;
+}
+
+void BinaryFile::addChunk(size_t bytes, size_t frames, uint32_t crc) {
+    payload_bytes += bytes;
+    chunk_crc = crc;
+    endChunk(frames);
+}
+
+void BinaryFile::appendTail(std::vector<write_segment>& segments) {
+    if (chunked()) {
+        footer.index_offset = headerSegment().size + payload_bytes;
+        footer.chunk_count = uint32_t(chunks.size());
+        footer.index_crc = crc32c(0, chunks.data(), chunks.size() * sizeof(ChunkEntry));
+        segments.push_back({ chunks.data(), chunks.size() * sizeof(ChunkEntry) });
+        segments.push_back({ &footer, sizeof(footer) });
     }
-    OutputFile.write(reinterpret_cast<const char*>(Data.data()), Data.size() * sizeof(double));
+    segments.push_back({ &trailer, sizeof(trailer) });
+}
 
-    if (OutputFile.fail()) {
-        std::cout << "Error writing to the file. " << std::endl;
+int BinaryFile::insertData(const std::vector<double>& Data){
+    const size_t channels = size_t(std::max(1, channelCount()));
+    const bool integer = encoding() == sample_encoding::int16 || encoding() == sample_encoding::int24;
+    if (integer && channels > 1 && options.layout == sample_layout::planar) {
+        std::cerr << "Error writing to the file " << file_name_location << ": planar integer samples need writeAcquisition\n";
         return 1;
     }
-    else {
-        dataRecordCount += Data.size();
+    if (!open(0)) {
+        return 1;
+    }
+    const double* values = Data.data();
+    if (integer && channels > 1) {
+        // Interleaved: each value scaled for its channel
+        scaled.resize(Data.size());
+        for (size_t i = 0; i < Data.size(); i++) {
+            scaled[i] = Data[i] * inverse_scale[(dataRecordCount + i) % channels];
+        }
+        values = scaled.data();
+    }
+    bool written = true;
+    if (!header_written) {
+        const write_segment head = headerSegment();
+        written = writeOut(&head, 1);
+        header_written = true;
     }
+    if (chunked()) {
+        // Whole chunks go out as they fill up; the rest waits in pending for more data or close()
+        pending.insert(pending.end(), values, values + Data.size());
+        const size_t chunk_values = size_t(header_v4.chunk_frames) * channels;
+        size_t first = 0;
+        for (; written && pending.size() - first >= chunk_values; first += chunk_values) {
+            const write_segment segment = insertedChunk(pending.data() + first, size_t(header_v4.chunk_frames));
+            addToChunk(&segment, 1);
+            endChunk(size_t(header_v4.chunk_frames));
+            written = writeOut(&segment, 1);
+        }
+        pending.erase(pending.begin(), pending.begin() + ptrdiff_t(first));
+    }
+    else if (written) {
+        const write_segment segment = encodeValues(values, Data.size(), insertInverseScale());
+        written = writeOut(&segment, 1);
+    }
+    if (!written) {
+        std::cerr << "Error writing to the file " << file_name_location << "\n";
+        return 1;
+    }
+    dataRecordCount += (unsigned int)Data.size();
     return 0;
 }
-int BinaryFile::close() {
-    if (!OutputFile.is_open()) {
-        std::cout << "Error close the binary file! file cannot be opened!" << std::endl;
+
+int BinaryFile::writeAll(const std::vector<double>& Data, thread_pool* pool) {
+    if (opened) {
+        // Something was written already; append the usual way
+        if (insertData(Data) != 0) {
+            return 1;
+        }
+        return close();
+    }
+    return writeAcquisition(Data.data(), Data.size() / size_t(std::max(1, channelCount())), pool);
+}
+
+int BinaryFile::writeAcquisition(const double* planar, size_t samples, thread_pool* pool) {
+    const size_t channels = size_t(channelCount());
+    const size_t values = samples * channels;
+    const write_segment head = headerSegment();
+    // Unchunked files are one chunk, without an index
+    const size_t chunk = chunked() ? size_t(header_v4.chunk_frames) : std::max<size_t>(samples, 1);
+    const size_t chunk_count = chunked() ? (samples + chunk - 1) / chunk : 0;
+    const size_t tail = chunked() ? chunk_count * sizeof(ChunkEntry) + sizeof(footer) : 0;
+    // The size of compressed chunks is known once they are compressed
+    const uint64_t size = compressed() ? 0 : head.size + values * encoded_size(encoding()) + tail + sizeof(trailer);
+    if (opened || !open(size)) {
+        return 1;
+    }
+    dataRecordCount = (unsigned int)values;
+    trailer.recordCount = (unsigned int)samples;
+    header_written = true;
+    chunks.reserve(chunk_count);
+    bool written;
+    const bool interleaved = format_version == multi_channel_version && options.layout == sample_layout::interleaved && channels > 1;
+    if (compressed()) {
+        // Chunks are independent: a batch of them is compressed and checksummed from the channels' slices of
+        // planar, on the pool when there is one, then the batch goes out in order in one gathered write
+        const size_t batch = pool != nullptr ? 2 * pool->size() : 1;
+        std::vector<chunk_buffers> buffers(std::min(batch, chunk_count));
+        const auto compress = [&](size_t first_chunk, size_t i) {
+            const size_t first = (first_chunk + i) * chunk;
+            const double* sources[4];
+            for (size_t c = 0; c < channels; c++) {
+                sources[c] = planar + c * samples + first;
+            }
+            const write_segment segment = compressChunk(sources, 1, std::min(chunk, samples - first), inverse_scale, buffers[i]);
+            buffers[i].crc = crc32c(0, segment.data, segment.size);
+        };
+        std::vector<write_segment> segments;
+        segments.push_back(head);
+        written = true;
+        for (size_t first_chunk = 0; written && first_chunk < chunk_count; first_chunk += batch) {
+            const size_t count = std::min(batch, chunk_count - first_chunk);
+            if (pool != nullptr && count > 1) {
+                pool->parallel_for(count, [&](size_t i) { compress(first_chunk, i); });
+            }
+            else {
+                for (size_t i = 0; i < count; i++) {
+                    compress(first_chunk, i);
+                }
+            }
+            for (size_t i = 0; i < count; i++) {
+                const size_t first = (first_chunk + i) * chunk;
+                segments.push_back({ buffers[i].packed.data(), buffers[i].packed.size() });
+                addChunk(buffers[i].packed.size(), std::min(chunk, samples - first), buffers[i].crc);
+            }
+            written = writeOut(segments.data(), segments.size());
+            segments.clear();
+        }
+        appendTail(segments);
+        written = written && writeOut(segments.data(), segments.size());
+    }
+    else if (encoding() == sample_encoding::float64 && !interleaved) {
+        // Every chunk is each channel's slice of its frames, gathered straight from planar into one write
+        std::vector<write_segment> segments;
+        segments.reserve(1 + (chunk_count + 1) * channels + 3);
+        segments.push_back(head);
+        for (size_t first = 0; first < samples; first += chunk) {
+            const size_t n = std::min(chunk, samples - first);
+            for (size_t c = 0; c < channels; c++) {
+                segments.push_back({ planar + c * samples + first, n * sizeof(double) });
+                addToChunk(&segments.back(), 1);
+            }
+            endChunk(n);
+        }
+        appendTail(segments);
+        written = writeOut(segments.data(), segments.size());
+    }
+    else {
+        // A block of frames at a time: transposed (and scaled per channel) for interleaved, encoded for narrower
+        // samples
+        constexpr size_t block_frames = 2048;
+        std::vector<double> block(interleaved ? block_frames * channels : 0);
+        written = writeOut(&head, 1);
+        for (size_t first = 0; written && first < samples; first += chunk) {
+            const size_t chunk_end = std::min(samples, first + chunk);
+            if (interleaved) {
+                for (size_t from = first; written && from < chunk_end; from += block_frames) {
+                    const size_t n = std::min(block_frames, chunk_end - from);
+                    for (size_t c = 0; c < channels; c++) {
+                        const double* in = planar + c * samples + from;
+                        const double inverse = inverse_scale[c];
+                        for (size_t i = 0; i < n; i++) {
+                            block[i * channels + c] = in[i] * inverse;
+                        }
+                    }
+                    const write_segment segment = encodeValues(block.data(), n * channels, 1.0);
+                    addToChunk(&segment, 1);
+                    written = writeOut(&segment, 1);
+                }
+            }
+            else {
+                for (size_t c = 0; c < channels; c++) {
+                    for (size_t from = first; written && from < chunk_end; from += block_frames) {
+                        const size_t n = std::min(block_frames, chunk_end - from);
+                        const write_segment segment = encodeValues(planar + c * samples + from, n, inverse_scale[c]);
+                        addToChunk(&segment, 1);
+                        written = writeOut(&segment, 1);
+                    }
+                }
+            }
+            endChunk(chunk_end - first);
+        }
+        std::vector<write_segment> segments;
+        appendTail(segments);
+        written = written && writeOut(segments.data(), segments.size());
+    }
+    if (!finish(written)) {
+        std::cerr << "Error writing the binary file " << file_name_location << "\n";
         return 1;
     }
-    FileTrailer trailer;
-    trailer.recordCount = dataRecordCount;
-    OutputFile.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    return 0;
+}
 
-    OutputFile.close();
+void* BinaryFile::mapData(size_t values) {
+    if (chunked() || encoding() != sample_encoding::float64) {
+        return nullptr;
+    }
+    const write_segment head = headerSegment();
+    if (!open(opened ? 0 : head.size + values * sizeof(double) + sizeof(trailer))) {
+        return nullptr;
+    }
+    if (!header_written) {
+        if (!writeOut(&head, 1)) {
+            return nullptr;
+        }
+        header_written = true;
+    }
+    void* data = output->map_next(values * sizeof(double));
+    if (data != nullptr) {
+        dataRecordCount += (unsigned int)values;
+        bytes_written += values * sizeof(double);
+    }
+    return data;
+}
 
-    if (OutputFile.fail()) {
-        std::cout << "Error binary file saving trailer." << std::endl;
+int BinaryFile::close() {
+    if (!open(0) || !output->is_open()) {
         return 1;
     }
-    else {
-        std::cout << "saved " << dataRecordCount << " data records." << std::endl;
+    trailer.recordCount = dataRecordCount / (unsigned int)std::max(1, channelCount());
+    std::vector<write_segment> segments;
+    if (!header_written) {
+        segments.push_back(headerSegment());
+        header_written = true;
+    }
+    if (!pending.empty()) {
+        // The last, short chunk
+        segments.push_back(insertedChunk(pending.data(), pending.size() / size_t(std::max(1, channelCount()))));
+        addToChunk(&segments.back(), 1);
+        endChunk(pending.size() / size_t(std::max(1, channelCount())));
+    }
+    appendTail(segments);
+    const bool written = writeOut(segments.data(), segments.size());
+    pending.clear();
+    if (!finish(written)) {
+        std::cerr << "Error binary file saving trailer: " << file_name_location << "\n";
+        return 1;
     }
     return 0;
 }
 
 BinaryFile::~BinaryFile() {
-    if (OutputFile.is_open()) {
+    if (output && output->is_open()) {
         close();
     }
 }
@@ -94,9 +530,18 @@ BinaryFile::~BinaryFile() {
 FileHeader BinaryFile::getHeader() const {
     return header;
 }
+FileHeaderV4 BinaryFile::getHeaderV4() const {
+    return header_v4;
+}
+int BinaryFile::channelCount() const {
+    return format_version == multi_channel_version ? header_v4.channel_count : 1;
+}
 FileTrailer BinaryFile::getTrailer() const {
     return trailer;
 }
+uint64_t BinaryFile::bytesWritten() const {
+    return bytes_written;
+}
 
 
 
@@ -1,8 +1,12 @@
 #pragma once
-#include <iostream>
-#include <fstream>
 #include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <ctime>
 #include "ACQConfig.hpp"
+#include "file_backend.hpp"
+#include "thread_pool.hpp"
 // Define the structure of the header
 struct FileHeader {
     char signature[4];      // Signature, e.g., "PDAT"
@@ -13,32 +17,164 @@ struct FileHeader {
     int sensitivity;        // Sensor sensitivity
     int channel_num;        // Number of the channel
     char date[20];          // Creation date (YYYY-MM-DD HH:MM:SS)
-    char reserved[52];      // Reserved space for future use
+    int encoding;           // sample_encoding; 0 (float64) in files from before it existed
+    float scale;            // Integer encodings: sample = count * scale
+    char reserved[44];      // Reserved space for future use
 };
+static_assert(sizeof(FileHeader) == 100, "the v3 header is 100 bytes on disk");
+// One entry of the v4 channel table, from ACQCONFIG::channels
+struct ChannelEntry {
+    int channel_num;        // DAQ channel (0-3)
+    int sensor_type;        // Sensor type, e.g., 1 for vibration and 0 for tacho
+    int sensitivity;        // Sensor sensitivity
+    float scale;            // Integer encodings: sample = count * scale
+};
+// Header of version 4: one acquisition of several channels in one file. 256 bytes, so the samples after it are
+// aligned for double.
+struct FileHeaderV4 {
+    char signature[4];      // "PDAT"
+    int version;            // 4, at the same offset as in FileHeader
+    int serial_num;         // DAQ serial number
+    int smpl_freq;          // Sampling frequency
+    int channel_count;      // Entries used in channels
+    int layout;             // sample_layout: 0 planar (channel after channel), 1 interleaved (frame after frame)
+    int acq_duration;       // Seconds per acquisition
+    int acq_interval;       // Seconds between acquisitions
+    char date[20];          // Creation date (YYYY-MM-DD HH:MM:SS)
+    ChannelEntry channels[4];
+    int chunk_frames;       // Samples per channel in each chunk; 0: one payload without chunk index
+    int encoding;           // sample_encoding of every sample
+    int codec;              // sample_codec of every chunk; 0: chunks hold the samples as they are
+    char reserved[128];     // Reserved space for future use
+};
+static_assert(sizeof(FileHeaderV4) == 256, "the v4 header is 256 bytes on disk");
+// A chunked v4 file is the header, the chunks, their index (one ChunkEntry per chunk), a ChunkFooter and the
+// FileTrailer, so a reader finds the index from the last 20 bytes. Each chunk holds chunk_frames samples of every
+// channel (the last one may hold fewer), in the file's layout within the chunk. A compressed chunk is instead the
+// compressed size of each channel's samples (uint32_t per channel), then those compressed samples, channel after
+// channel whatever the layout; the layout is what the reader gets back.
+struct ChunkEntry {
+    uint64_t offset;        // File offset of the chunk
+    uint32_t bytes;         // Size of the chunk on disk
+    uint32_t frames;        // Samples per channel in the chunk
+    uint32_t crc;           // CRC-32C of the chunk's bytes
+    uint32_t reserved;
+};
+static_assert(sizeof(ChunkEntry) == 24, "chunk entries are 24 bytes on disk");
+struct ChunkFooter {
+    uint64_t index_offset;  // File offset of the first ChunkEntry
+    uint32_t chunk_count;
+    uint32_t index_crc;     // CRC-32C of the chunk_count entries
+};
+static_assert(sizeof(ChunkFooter) == 16, "the chunk footer is 16 bytes on disk");
 // Trailer to store information at the end of the file
 struct FileTrailer {
-    unsigned int recordCount;      // Number of records in the file
+    unsigned int recordCount;      // Number of records in the file (v4: samples per channel)
     //unsigned int checksum;         // Simple checksum for validation (sum of all data)
 };
+// What one thread needs to compress a chunk
+struct chunk_buffers {
+    std::vector<double> gathered;        // one channel's samples of an interleaved chunk
+    std::vector<unsigned char> encoded;  // one channel's samples as the file stores them
+    std::vector<unsigned char> packed;   // the compressed chunk
+    uint32_t crc = 0;                    // of packed
+};
 
+// The file is opened on the first write, and the header goes out with the first data. It is written as
+// temp_name_location (.temp, a name no other BinaryFile uses, created exclusively) and renamed to
+// file_name_location (.bin) once closed, after the fsyncs options.fsync asks for, so a .bin file is always
+// complete; if writing fails the .temp file is removed instead. The name is
+// the acquisition's time, to the second (and the channel, for one channel): a .bin file of that name already there
+// is never replaced, the write fails instead.
+// Version 3 (the default) holds one channel. Version 4 holds a channel table and the samples of every channel
+// in it, planar or interleaved as options.layout says, optionally cut into checksummed chunks with an index
+// (options.chunk_frames), which may be compressed (options.compress). Either stores samples as options.encoding
+// says, converting from double on the way out.
 class BinaryFile {
 public:
-    BinaryFile(const std::string& localDataFolder, ACQCONFIG& config, int channel_num);
+    // One channel, in the format options.version says. acquired names the file and dates the header; 0 is now.
+    BinaryFile(const std::string& localDataFolder, ACQCONFIG& config, int channel_num, const file_options& options = file_options(), time_t acquired = 0);
+    // Every channel of config whose status is 1, in one version 4 file
+    BinaryFile(const std::string& localDataFolder, ACQCONFIG& config, const file_options& options = file_options(), time_t acquired = 0);
     ~BinaryFile();
-    int insertData(std::vector<double>& Data);
+    // Appends values as they are laid out in the file. With an integer encoding a multi-channel planar file has
+    // no way to tell which channel a value belongs to, so it refuses; use writeAcquisition() for those.
+    int insertData(const std::vector<double>& Data);
+    // Header, Data and trailer in one gathered write, then closes the file
+    int writeAll(const std::vector<double>& Data, thread_pool* pool = nullptr);
+    // One acquisition of every channel of the file, given planar (samples of the first channel, then the
+    // second...), in the file's layout; then closes the file. Planar goes out in one gathered write. Compressed
+    // chunks are compressed on pool when there is one, a batch at a time, and each batch written in order.
+    int writeAcquisition(const double* planar, size_t samples, thread_pool* pool = nullptr);
+    // Space for values doubles in the file itself, to be filled in place in the file's layout, with the header
+    // written and the trailer left to close(). A v3 payload starts at byte 100, so the pointer is not aligned
+    // for double: copy samples in with memcpy. nullptr when the backend cannot map, the file is chunked (the
+    // chunks are checksummed on the way out), its samples are not doubles or it cannot be opened; write the
+    // samples with insertData() then.
+    void* mapData(size_t values);
     int close();
     FileHeader getHeader() const;
+    FileHeaderV4 getHeaderV4() const;
+    int channelCount() const;
     FileTrailer getTrailer() const;
+    // Bytes handed to the file so far: header, samples as stored (encoded, compressed) and tail. Once closed,
+    // the size of the file.
+    uint64_t bytesWritten() const;
     std::string filename_wihout_extension;
     std::string file_name_location;
+    std::string temp_name_location;
     std::string filename_org;
     std::string filename_temp;
 
 protected:
-    std::ofstream OutputFile;
+    bool open(uint64_t expected_size);
+    // output->write(), counting what it wrote
+    bool writeOut(const write_segment* segments, size_t count);
+    // Closes the file and, if everything was written, publishes it under its final name; false otherwise
+    bool finish(bool written);
+    void initHeaderV4(ACQCONFIG& config, const int* channels, int count, time_t acquired);
+    write_segment headerSegment() const;
+    bool chunked() const;
+    sample_encoding encoding() const;
+    bool compressed() const;
+    // values as the file stores them: the doubles themselves, or converted into encoded (valid until the next call)
+    write_segment encodeValues(const double* values, size_t count, double inverse_scale);
+    // One compressed chunk of frames samples per channel, channel c's i-th at sources[c][i * stride], encoded with
+    // inverse[c], into buffers.packed. Leaves the file alone, so several threads may compress at once.
+    write_segment compressChunk(const double* const* sources, size_t stride, size_t frames, const double* inverse, chunk_buffers& buffers) const;
+    // A chunk of frames insertData() values per channel, as the file stores it (valid until the next call)
+    write_segment insertedChunk(const double* values, size_t frames);
+    // The inverse scale insertData() values are encoded with; multi-channel values are scaled per channel first
+    double insertInverseScale() const;
+    // Checksums data segments into the current chunk
+    void addToChunk(const write_segment* segments, size_t count);
+    void endChunk(size_t frames);
+    // A whole chunk of bytes whose CRC-32C is known already
+    void addChunk(size_t bytes, size_t frames, uint32_t crc);
+    // Appends the chunk index and footer (chunked files) and the trailer to segments
+    void appendTail(std::vector<write_segment>& segments);
+
+    file_options options;
+    std::unique_ptr<file_backend> output;
+    bool opened = false;
+    bool header_written = false;
+    int format_version;     // 3 or 4
     FileHeader header;
+    FileHeaderV4 header_v4;
     FileTrailer trailer;
     unsigned int dataRecordCount;
+    // Chunked files
+    std::vector<ChunkEntry> chunks;
+    ChunkFooter footer;
+    std::vector<double> pending;     // insertData() values short of a whole chunk
+    std::vector<unsigned char> encoded;  // samples converted for the file
+    std::vector<double> scaled;          // interleaved values scaled per channel
+    chunk_buffers compression;           // insertData() chunks
+    double inverse_scale[4] = { 1, 1, 1, 1 };  // per channel of the file, for integer encodings
+    uint64_t payload_bytes = 0;      // data written after the header
+    uint64_t bytes_written = 0;      // all of the file, for bytesWritten()
+    uint64_t chunk_start = 0;        // payload_bytes where the current chunk began
+    uint32_t chunk_crc = 0;
 };
 //std::ofstream initBinaryFile(std::string file_location, int version, std::string dateTime);
 //int saveDataBinary(const double* Data, size_t DataSize, std::ofstream &OutputFile);
@@ -0,0 +1,399 @@
+#include <cstring>
+#include <fstream>
+#include "binary_file_reader.hpp"
+#include "crc32c.hpp"
+#include "sample_encoding.hpp"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+BinaryFileReader::BinaryFileReader(const std::string& path, thread_pool* pool) {
+    open(path, pool);
+}
+
+BinaryFileReader::~BinaryFileReader() {
+    close();
+}
+
+bool BinaryFileReader::open(const std::string& file_path, thread_pool* pool) {
+    close();
+    path = file_path;
+#ifndef _WIN32
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return fail("cannot be opened");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return fail("cannot be opened");
+    }
+    size = size_t(st.st_size);
+    if (size > 0) {
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);  // the mapping keeps the file
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        return fail("cannot be mapped");
+    }
+    bytes = static_cast<const unsigned char*>(mapping);
+#else
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    if (!input.is_open()) {
+        return fail("cannot be opened");
+    }
+    size = size_t(input.tellg());
+    storage.resize((size + 7) / 8);
+    input.seekg(0);
+    if (!input.read(reinterpret_cast<char*>(storage.data()), std::streamsize(size))) {
+        return fail("cannot be read");
+    }
+    bytes = reinterpret_cast<const unsigned char*>(storage.data());
+#endif
+    valid = parse(pool);
+    return valid;
+}
+
+bool BinaryFileReader::parse(thread_pool* pool) {
+    const int v3 = 3;
+    const int v4 = 4;
+    if (size < sizeof(FileHeader) + sizeof(FileTrailer)) {
+        return fail("too short for a PDAT file");
+    }
+    if (memcmp(bytes, "PDAT", 4) != 0) {
+        return fail("no PDAT signature");
+    }
+    memcpy(&format_version, bytes + 4, sizeof(format_version));
+    memcpy(&trailer, bytes + size - sizeof(trailer), sizeof(trailer));
+    const uint64_t records = trailer.recordCount;
+    int stored_encoding;
+    if (format_version == v3) {
+        memcpy(&header, bytes, sizeof(header));
+        stored_encoding = header.encoding;
+    }
+    else if (format_version == v4) {
+        if (size < sizeof(header_v4) + sizeof(trailer)) {
+            return fail("too short for a version 4 file");
+        }
+        memcpy(&header_v4, bytes, sizeof(header_v4));
+        stored_encoding = header_v4.encoding;
+    }
+    else {
+        return fail("unknown version " + std::to_string(format_version));
+    }
+    if (stored_encoding < int(sample_encoding::float64) || stored_encoding > int(sample_encoding::int24)) {
+        return fail("unknown sample encoding");
+    }
+    sample_format = sample_encoding(stored_encoding);
+    const size_t sample_bytes = encoded_size(sample_format);
+    const bool integer = sample_format == sample_encoding::int16 || sample_format == sample_encoding::int24;
+
+    if (format_version == v3) {
+        if (size != sizeof(header) + records * sample_bytes + sizeof(trailer)) {
+            return fail("record count does not match the file size");
+        }
+        if (integer) {
+            scales[0] = header.scale;
+        }
+        // Not aligned for double, or not doubles: the one copy
+        copied.resize(size_t(records));
+        decode(bytes + sizeof(header), copied.size(), 0);
+        payload = copied.data();
+        values = copied.size();
+        return true;
+    }
+
+    const int count = header_v4.channel_count;
+    if (count < 1 || count > 4) {
+        return fail("bad channel count");
+    }
+    if (header_v4.layout != int(sample_layout::planar) && header_v4.layout != int(sample_layout::interleaved)) {
+        return fail("bad sample layout");
+    }
+    if (header_v4.chunk_frames < 0) {
+        return fail("bad chunk size");
+    }
+    if (header_v4.codec < int(sample_codec::none) || header_v4.codec > int(sample_codec::int_delta)) {
+        return fail("unknown codec");
+    }
+    chunk_codec = sample_codec(header_v4.codec);
+    const bool compressed = chunk_codec != sample_codec::none;
+    if (compressed && (header_v4.chunk_frames == 0 || chunk_codec != codec_for(sample_format))) {
+        return fail("codec does not match the chunks or the sample encoding");
+    }
+    for (int c = 0; c < count && integer; c++) {
+        scales[c] = header_v4.channels[c].scale;
+    }
+    const uint64_t total = records * uint64_t(count);
+    const uint64_t payload_bytes = total * sample_bytes;
+    values = size_t(total);
+    if (header_v4.chunk_frames == 0) {
+        if (size != sizeof(header_v4) + payload_bytes + sizeof(trailer)) {
+            return fail("record count does not match the file size");
+        }
+    }
+    else {
+        // Chunked: header, chunks, index, footer, trailer
+        ChunkFooter footer;
+        if (size < sizeof(header_v4) + sizeof(footer) + sizeof(trailer)) {
+            return fail("too short for a chunked file");
+        }
+        memcpy(&footer, bytes + size - sizeof(trailer) - sizeof(footer), sizeof(footer));
+        const uint64_t index_bytes = uint64_t(footer.chunk_count) * sizeof(ChunkEntry);
+        // Each bound on its own, so a forged footer cannot wrap the sum around to the file size
+        const uint64_t index_space = size - sizeof(header_v4) - sizeof(footer) - sizeof(trailer);
+        if (index_bytes > index_space || footer.index_offset < sizeof(header_v4)
+            || footer.index_offset > size - sizeof(footer) - sizeof(trailer) - index_bytes
+            || footer.index_offset + index_bytes + sizeof(footer) + sizeof(trailer) != size) {
+            return fail("chunk index does not fit the file");
+        }
+        // The size of compressed chunks says nothing about the record count
+        if (!compressed && footer.index_offset != sizeof(header_v4) + payload_bytes) {
+            return fail("record count and chunk index do not match the file size");
+        }
+        if (crc32c(0, bytes + footer.index_offset, size_t(index_bytes)) != footer.index_crc) {
+            return fail("chunk index checksum mismatch");
+        }
+        chunks.resize(footer.chunk_count);
+        chunk_first.resize(footer.chunk_count);
+        if (index_bytes > 0) {
+            memcpy(chunks.data(), bytes + footer.index_offset, size_t(index_bytes));
+        }
+        // The chunks must tile the payload exactly
+        uint64_t offset = sizeof(header_v4);
+        uint64_t frames = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const ChunkEntry& entry = chunks[i];
+            const uint64_t stored = compressed ? entry.bytes : uint64_t(entry.frames) * uint64_t(count) * sample_bytes;
+            // A compressed chunk holds at least each channel's stream size and the block headers of its frames, so
+            // a forged frame count cannot make the samples outgrow what the file could hold
+            const uint64_t least = compressed ? uint64_t(count) * (sizeof(uint32_t) + min_compressed_size(entry.frames)) : 0;
+            if (entry.offset != offset || entry.bytes != stored || entry.bytes < least
+                || entry.frames == 0 || entry.frames > uint32_t(header_v4.chunk_frames)) {
+                return fail("bad chunk index entry");
+            }
+            chunk_first[i] = size_t(frames) * size_t(count);
+            offset += entry.bytes;
+            frames += entry.frames;
+        }
+        if (frames != records) {
+            return fail("chunk index does not add up to the record count");
+        }
+        if (offset != footer.index_offset) {
+            return fail("chunks do not end at the chunk index");
+        }
+    }
+    if (sample_format == sample_encoding::float64 && !compressed) {
+        payload = reinterpret_cast<const double*>(bytes + sizeof(header_v4));
+        return true;
+    }
+    copied.resize(values);
+    if (chunks.empty()) {
+        decode(bytes + sizeof(header_v4), size_t(records), 0);
+    }
+    // Every chunk decodes into its own part of copied, so they can go in any order
+    std::vector<char> decoded(chunks.size(), 1);
+    const auto expand = [&](size_t i) {
+        if (!compressed) {
+            decode(bytes + chunks[i].offset, chunks[i].frames, chunk_first[i]);
+        }
+        else {
+            decoded[i] = decompress(chunks[i], chunk_first[i]);
+        }
+    };
+    if (pool != nullptr && chunks.size() > 1) {
+        pool->parallel_for(chunks.size(), expand);
+    }
+    else {
+        for (size_t i = 0; i < chunks.size(); i++) {
+            expand(i);
+        }
+    }
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (!decoded[i]) {
+            return fail("chunk " + std::to_string(i) + " cannot be decompressed");
+        }
+    }
+    payload = copied.data();
+    return true;
+}
+
+void BinaryFileReader::decode(const unsigned char* in, size_t frames, size_t first) {
+    const size_t count = size_t(channelCount());
+    const size_t sample_bytes = encoded_size(sample_format);
+    double* out = copied.data() + first;
+    if (count == 1 || layout() == sample_layout::planar) {
+        for (size_t c = 0; c < count; c++) {
+            decode_samples(sample_format, in + c * frames * sample_bytes, frames, scales[c], out + c * frames);
+        }
+        return;
+    }
+    bool same_scale = true;
+    for (size_t c = 1; c < count; c++) {
+        same_scale &= scales[c] == scales[0];
+    }
+    decode_samples(sample_format, in, frames * count, same_scale ? scales[0] : 1.0, out);
+    if (!same_scale) {
+        for (size_t i = 0; i < frames * count; i++) {
+            out[i] *= scales[i % count];
+        }
+    }
+}
+
+bool BinaryFileReader::decompress(const ChunkEntry& entry, size_t first) {
+    const size_t count = size_t(channelCount());
+    const size_t frames = entry.frames;
+    const bool interleaved = count > 1 && layout() == sample_layout::interleaved;
+    const unsigned char* in = bytes + entry.offset;
+    std::vector<unsigned char> stored(frames * encoded_size(sample_format));
+    std::vector<double> channel_values(interleaved ? frames : 0);
+    double* out = copied.data() + first;
+    // Stream sizes, then the streams, channel after channel
+    size_t at = count * sizeof(uint32_t);
+    for (size_t c = 0; c < count; c++) {
+        uint32_t stream;
+        memcpy(&stream, in + c * sizeof(uint32_t), sizeof(stream));
+        if (stream > entry.bytes - at || !decompress_samples(sample_format, in + at, stream, frames, stored.data())) {
+            return false;
+        }
+        at += stream;
+        if (!interleaved) {
+            decode_samples(sample_format, stored.data(), frames, scales[c], out + c * frames);
+            continue;
+        }
+        decode_samples(sample_format, stored.data(), frames, scales[c], channel_values.data());
+        for (size_t i = 0; i < frames; i++) {
+            out[i * count + c] = channel_values[i];
+        }
+    }
+    return at == entry.bytes;
+}
+
+bool BinaryFileReader::fail(const std::string& reason) {
+    const std::string file = path;
+    close();
+    path = file;
+    message = file + ": " + reason;
+    return false;
+}
+
+void BinaryFileReader::close() {
+#ifndef _WIN32
+    if (mapping != nullptr) {
+        munmap(mapping, size);
+    }
+#endif
+    mapping = nullptr;
+    bytes = nullptr;
+    size = 0;
+    storage.clear();
+    copied.clear();
+    chunks.clear();
+    chunk_first.clear();
+    sample_format = sample_encoding::float64;
+    chunk_codec = sample_codec::none;
+    for (double& scale : scales) {
+        scale = 1;
+    }
+    payload = nullptr;
+    values = 0;
+    format_version = 0;
+    valid = false;
+    header = {};
+    header_v4 = {};
+    trailer = {};
+    message.clear();
+}
+
+bool BinaryFileReader::isOpen() const {
+    return valid;
+}
+
+const std::string& BinaryFileReader::error() const {
+    return message;
+}
+
+int BinaryFileReader::version() const {
+    return format_version;
+}
+
+int BinaryFileReader::channelCount() const {
+    return format_version == 4 ? header_v4.channel_count : (format_version == 3 ? 1 : 0);
+}
+
+int BinaryFileReader::channelNumber(int index) const {
+    return format_version == 4 ? header_v4.channels[index].channel_num : header.channel_num;
+}
+
+sample_layout BinaryFileReader::layout() const {
+    return format_version == 4 ? sample_layout(header_v4.layout) : sample_layout::planar;
+}
+
+sample_encoding BinaryFileReader::encoding() const {
+    return sample_format;
+}
+
+sample_codec BinaryFileReader::codec() const {
+    return chunk_codec;
+}
+
+size_t BinaryFileReader::samples() const {
+    return trailer.recordCount;
+}
+
+FileHeader BinaryFileReader::getHeader() const {
+    return header;
+}
+
+FileHeaderV4 BinaryFileReader::getHeaderV4() const {
+    return header_v4;
+}
+
+FileTrailer BinaryFileReader::getTrailer() const {
+    return trailer;
+}
+
+std::span<const double> BinaryFileReader::data() const {
+    return { payload, values };
+}
+
+std::span<const double> BinaryFileReader::channel(int index) const {
+    const int count = channelCount();
+    if (index < 0 || index >= count) {
+        return {};
+    }
+    if (count > 1 && (!chunks.empty() || layout() != sample_layout::planar)) {
+        return {};
+    }
+    return { payload + size_t(index) * samples(), samples() };
+}
+
+size_t BinaryFileReader::chunkCount() const {
+    return chunks.size();
+}
+
+ChunkEntry BinaryFileReader::chunk(size_t index) const {
+    return chunks[index];
+}
+
+std::span<const double> BinaryFileReader::chunkData(size_t index) const {
+    return { payload + chunk_first[index], size_t(chunks[index].frames) * size_t(channelCount()) };
+}
+
+bool BinaryFileReader::verifyChunk(size_t index) const {
+    const ChunkEntry& entry = chunks[index];
+    return crc32c(0, bytes + entry.offset, entry.bytes) == entry.crc;
+}
+
+bool BinaryFileReader::verifyChunks() const {
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (!verifyChunk(i)) {
+            return false;
+        }
+    }
+    return true;
+}
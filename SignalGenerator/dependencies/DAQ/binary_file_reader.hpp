@@ -0,0 +1,89 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "binary_file.hpp"
+#include "sample_codec.hpp"
+#include "thread_pool.hpp"
+
+// Reads a PDAT file written by BinaryFile: version 3 (one channel) or 4 (a channel table, optionally chunked).
+// open() maps the file read-only and checks the signature, the version, the header fields and that the trailer's
+// record count (and, for chunked files, the chunk index) accounts for the file size exactly. The samples are then
+// spans straight into the mapping. A version 3 payload starts at byte 100, which is not aligned for double, so
+// those samples are copied once at open(), and samples stored as float32 or integers are decoded to doubles
+// there, as are compressed chunks decompressed. Where mmap is missing the file is read into memory instead.
+class BinaryFileReader {
+public:
+    BinaryFileReader() = default;
+    explicit BinaryFileReader(const std::string& path, thread_pool* pool = nullptr);
+    ~BinaryFileReader();
+    BinaryFileReader(const BinaryFileReader&) = delete;
+    BinaryFileReader& operator=(const BinaryFileReader&) = delete;
+
+    // false, with error() saying why, when the file cannot be read or is not a valid PDAT file. Chunks that need
+    // decoding or decompressing are spread over pool when there is one.
+    bool open(const std::string& path, thread_pool* pool = nullptr);
+    void close();
+    bool isOpen() const;
+    const std::string& error() const;
+
+    int version() const;
+    int channelCount() const;
+    // Channel number (0-3) of the index-th channel in the file
+    int channelNumber(int index) const;
+    sample_layout layout() const;
+    sample_encoding encoding() const;
+    // How the chunks are compressed; none for files that are not
+    sample_codec codec() const;
+    // Samples per channel
+    size_t samples() const;
+    FileHeader getHeader() const;      // version 3
+    FileHeaderV4 getHeaderV4() const;  // version 4
+    FileTrailer getTrailer() const;
+
+    // Every sample, in file order (chunk after chunk for chunked files)
+    std::span<const double> data() const;
+    // The samples of the index-th channel when they are contiguous: a one-channel file, or a planar file without
+    // chunks. Empty otherwise; use chunkData() and the layout then.
+    std::span<const double> channel(int index) const;
+
+    // 0 for files without chunks
+    size_t chunkCount() const;
+    ChunkEntry chunk(size_t index) const;
+    // The samples of one chunk, in the file's layout (decoded)
+    std::span<const double> chunkData(size_t index) const;
+    // Checks a chunk's CRC-32C, over its bytes as stored
+    bool verifyChunk(size_t index) const;
+    // Checks every chunk; true for files without chunks, which have nothing to check
+    bool verifyChunks() const;
+
+private:
+    bool fail(const std::string& message);
+    bool parse(thread_pool* pool);
+    // Decodes frames samples per channel stored at in, in the file's layout, into copied at first
+    void decode(const unsigned char* in, size_t frames, size_t first);
+    // Decompresses and decodes a compressed chunk into copied at first; false when it is malformed
+    bool decompress(const ChunkEntry& entry, size_t first);
+
+    std::string path;
+    std::string message;
+    const unsigned char* bytes = nullptr;
+    size_t size = 0;
+    void* mapping = nullptr;           // the mapped file, or nullptr when read into storage
+    std::vector<uint64_t> storage;     // the file read into memory, 8-byte aligned, where mmap is missing
+    std::vector<double> copied;        // version 3 samples, aligned, or decoded samples
+    bool valid = false;
+    int format_version = 0;
+    FileHeader header{};
+    FileHeaderV4 header_v4{};
+    FileTrailer trailer{};
+    const double* payload = nullptr;
+    size_t values = 0;
+    std::vector<ChunkEntry> chunks;
+    std::vector<size_t> chunk_first;   // index in data() of each chunk's first value
+    sample_encoding sample_format = sample_encoding::float64;
+    sample_codec chunk_codec = sample_codec::none;
+    double scales[4] = { 1, 1, 1, 1 };
+};
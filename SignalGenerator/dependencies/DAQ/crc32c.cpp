@@ -0,0 +1,215 @@
+#include <cstring>
+#include <array>
+#include "crc32c.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC_X86 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles any intrinsic anywhere; GCC and Clang need the instruction set enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CRC_TARGET(isa)
+#else
+#define CRC_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace {
+
+const uint32_t POLY = 0x82F63B78;  // Castagnoli, reflected
+
+// tables[k][b]: CRC of byte b followed by k zero bytes
+using crc_tables = std::array<std::array<uint32_t, 256>, 8>;
+
+constexpr crc_tables make_tables() {
+    crc_tables tables{};
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (POLY & (0u - (crc & 1)));
+        }
+        tables[0][b] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (uint32_t b = 0; b < 256; b++) {
+            tables[k][b] = (tables[k - 1][b] >> 8) ^ tables[0][tables[k - 1][b] & 0xFF];
+        }
+    }
+    return tables;
+}
+
+constexpr crc_tables TABLES = make_tables();
+
+#ifdef CRC_X86
+
+// Shifting a CRC register over n zero bytes is linear over GF(2): a 32x32 bit matrix, applied a byte at a time
+// through four tables. This is what lets three independent crc32 streams be joined into one CRC.
+using shift_tables = std::array<std::array<uint32_t, 256>, 4>;
+
+constexpr uint32_t matrix_times(const uint32_t* matrix, uint32_t vector) {
+    uint32_t sum = 0;
+    for (; vector != 0; vector >>= 1, matrix++) {
+        if (vector & 1) {
+            sum ^= *matrix;
+        }
+    }
+    return sum;
+}
+
+constexpr shift_tables make_shift(size_t bytes) {
+    // Operator for one zero bit, squared to 2, 4, 8 bits (one byte), then squared again for every bit of bytes
+    std::array<uint32_t, 32> op{};
+    std::array<uint32_t, 32> square{};
+    op[0] = POLY;
+    for (int n = 1; n < 32; n++) {
+        op[n] = 1u << (n - 1);
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int n = 0; n < 32; n++) {
+            square[n] = matrix_times(op.data(), op[n]);
+        }
+        op = square;
+    }
+    std::array<uint32_t, 32> result{};
+    for (int n = 0; n < 32; n++) {
+        result[n] = 1u << n;
+    }
+    for (; bytes != 0; bytes >>= 1) {
+        if (bytes & 1) {
+            for (int n = 0; n < 32; n++) {
+                square[n] = matrix_times(op.data(), result[n]);
+            }
+            result = square;
+        }
+        for (int n = 0; n < 32; n++) {
+            square[n] = matrix_times(op.data(), op[n]);
+        }
+        op = square;
+    }
+    shift_tables tables{};
+    for (uint32_t b = 0; b < 256; b++) {
+        for (int k = 0; k < 4; k++) {
+            tables[k][b] = matrix_times(result.data(), b << (8 * k));
+        }
+    }
+    return tables;
+}
+
+const size_t LONG_BLOCK = 8192;
+const size_t SHORT_BLOCK = 256;
+const shift_tables SHIFT_LONG = make_shift(LONG_BLOCK);
+const shift_tables SHIFT_SHORT = make_shift(SHORT_BLOCK);
+
+uint32_t shift(const shift_tables& tables, uint32_t crc) {
+    return tables[0][crc & 0xFF] ^ tables[1][(crc >> 8) & 0xFF] ^ tables[2][(crc >> 16) & 0xFF] ^ tables[3][crc >> 24];
+}
+
+#endif
+
+uint32_t crc_table(uint32_t crc, const unsigned char* p, size_t size) {
+    crc = ~crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;  // little-endian, like every target of this project
+        crc = TABLES[7][lo & 0xFF] ^ TABLES[6][(lo >> 8) & 0xFF] ^ TABLES[5][(lo >> 16) & 0xFF] ^ TABLES[4][lo >> 24]
+            ^ TABLES[3][hi & 0xFF] ^ TABLES[2][(hi >> 8) & 0xFF] ^ TABLES[1][(hi >> 16) & 0xFF] ^ TABLES[0][hi >> 24];
+    }
+    for (; size > 0; size--, p++) {
+        crc = (crc >> 8) ^ TABLES[0][(crc ^ *p) & 0xFF];
+    }
+    return ~crc;
+}
+
+#ifdef CRC_X86
+
+// The crc32 instruction has a latency of 3 cycles but issues every cycle, so three streams over adjacent blocks run
+// at once and are joined with the shift tables (no PCLMUL needed)
+CRC_TARGET("sse4.2")
+uint64_t crc_sse42_blocks(uint64_t c, const unsigned char*& p, size_t& size, size_t block, const shift_tables& tables) {
+    for (; size >= 3 * block; size -= 3 * block, p += 3 * block) {
+        uint64_t c1 = 0;
+        uint64_t c2 = 0;
+        for (size_t i = 0; i < block; i += 8) {
+            uint64_t w0;
+            uint64_t w1;
+            uint64_t w2;
+            memcpy(&w0, p + i, 8);
+            memcpy(&w1, p + block + i, 8);
+            memcpy(&w2, p + 2 * block + i, 8);
+            c = _mm_crc32_u64(c, w0);
+            c1 = _mm_crc32_u64(c1, w1);
+            c2 = _mm_crc32_u64(c2, w2);
+        }
+        c = shift(tables, uint32_t(c)) ^ uint32_t(c1);
+        c = shift(tables, uint32_t(c)) ^ uint32_t(c2);
+    }
+    return c;
+}
+
+CRC_TARGET("sse4.2")
+uint32_t crc_sse42(uint32_t crc, const unsigned char* p, size_t size) {
+    uint64_t c = ~crc;
+    for (; size > 0 && (uintptr_t(p) & 7) != 0; size--, p++) {
+        c = _mm_crc32_u8(uint32_t(c), *p);
+    }
+    c = crc_sse42_blocks(c, p, size, LONG_BLOCK, SHIFT_LONG);
+    c = crc_sse42_blocks(c, p, size, SHORT_BLOCK, SHIFT_SHORT);
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        c = _mm_crc32_u64(c, w);
+    }
+    for (; size > 0; size--, p++) {
+        c = _mm_crc32_u8(uint32_t(c), *p);
+    }
+    return ~uint32_t(c);
+}
+
+bool has_sse42() {
+    unsigned r[4];
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    for (int i = 0; i < 4; i++) {
+        r[i] = unsigned(regs[i]);
+    }
+#else
+    __cpuid(1, r[0], r[1], r[2], r[3]);
+#endif
+    return (r[2] & (1u << 20)) != 0;
+}
+
+const bool HARDWARE = has_sse42();
+
+#else
+
+const bool HARDWARE = false;
+
+#endif
+
+}  // namespace
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t size) {
+#ifdef CRC_X86
+    if (HARDWARE) {
+        return crc_sse42(crc, static_cast<const unsigned char*>(data), size);
+    }
+#endif
+    return crc_table(crc, static_cast<const unsigned char*>(data), size);
+}
+
+uint32_t crc32c_portable(uint32_t crc, const void* data, size_t size) {
+    return crc_table(crc, static_cast<const unsigned char*>(data), size);
+}
+
+const char* crc32c_implementation() {
+    return HARDWARE ? "SSE4.2" : "table";
+}
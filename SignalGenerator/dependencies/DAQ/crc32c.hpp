@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli, as in iSCSI and ext4). crc32c(0, data, size) checksums a buffer; passing the result of
+// one call as crc continues it over the next buffer, so crc32c(crc32c(0, a, n), b, m) checksums a then b.
+// Uses the SSE4.2 crc32 instruction when the CPU has it, slicing-by-8 tables otherwise.
+uint32_t crc32c(uint32_t crc, const void* data, size_t size);
+// The table version, whatever the CPU
+uint32_t crc32c_portable(uint32_t crc, const void* data, size_t size);
+// "SSE4.2" or "table", whichever crc32c() uses here
+const char* crc32c_implementation();
@@ -0,0 +1,341 @@
+#ifdef __linux__
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "direct_io.hpp"
+
+namespace {
+
+unsigned load_acquire(unsigned* p) {
+    return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+}
+
+void store_release(unsigned* p, unsigned value) {
+    std::atomic_ref<unsigned>(*p).store(value, std::memory_order_release);
+}
+
+template <typename T>
+T* at(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+} // namespace
+
+direct_io_ring::direct_io_ring(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = int(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        return;  // old kernel, or io_uring disabled by seccomp or sysctl
+    }
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    cq_ring = single_mmap ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqe_memory_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqe_memory = mmap(nullptr, sqe_memory_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqe_memory == MAP_FAILED) {
+        if (sqe_memory != MAP_FAILED) {
+            munmap(sqe_memory, sqe_memory_size);
+        }
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring != MAP_FAILED) {
+            munmap(sq_ring, sq_ring_size);
+        }
+        ::close(fd);
+        return;
+    }
+    ring_fd = fd;
+    sq_entries = params.sq_entries;
+    cq_entries = params.cq_entries;
+    sq_head = at<unsigned>(sq_ring, params.sq_off.head);
+    sq_tail = at<unsigned>(sq_ring, params.sq_off.tail);
+    sq_mask = at<unsigned>(sq_ring, params.sq_off.ring_mask);
+    sq_array = at<unsigned>(sq_ring, params.sq_off.array);
+    cq_head = at<unsigned>(cq_ring, params.cq_off.head);
+    cq_tail = at<unsigned>(cq_ring, params.cq_off.tail);
+    cq_mask = at<unsigned>(cq_ring, params.cq_off.ring_mask);
+    cqes = at<void>(cq_ring, params.cq_off.cqes);
+}
+
+direct_io_ring::~direct_io_ring() {
+    if (ring_fd < 0) {
+        return;
+    }
+    munmap(sqe_memory, sqe_memory_size);
+    if (cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    munmap(sq_ring, sq_ring_size);
+    ::close(ring_fd);
+}
+
+direct_io_ring& direct_io_ring::shared() {
+    static direct_io_ring ring;
+    return ring;
+}
+
+void direct_io_ring::enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    while (syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0) < 0 && errno == EINTR) {
+    }
+}
+
+void direct_io_ring::write(int fd, const void* buffer, size_t size, uint64_t offset, direct_io_op& op) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Room in the SQ ring, and in the CQ ring for every write in flight
+    while (in_flight >= cq_entries || queued >= sq_entries) {
+        if (queued > 0) {
+            submit_locked();
+            continue;
+        }
+        if (reaping) {
+            reaped.wait(lock);
+            continue;
+        }
+        reaping = true;
+        lock.unlock();
+        enter(0, 1, IORING_ENTER_GETEVENTS);
+        lock.lock();
+        reaping = false;
+        reap_locked();
+        reaped.notify_all();
+    }
+    op.done = false;
+    op.result = 0;
+    const unsigned tail = *sq_tail;
+    const unsigned index = tail & *sq_mask;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqe_memory) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = uint64_t(uintptr_t(buffer));
+    sqe->len = unsigned(size);
+    sqe->off = offset;
+    sqe->user_data = uint64_t(uintptr_t(&op));
+    sq_array[index] = index;
+    store_release(sq_tail, tail + 1);
+    queued++;
+    in_flight++;
+}
+
+void direct_io_ring::submit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    submit_locked();
+}
+
+void direct_io_ring::submit_locked() {
+    if (queued > 0) {
+        enter(queued, 0, 0);
+        // The kernel consumed what it took from the SQ ring; anything left is retried on the next submit
+        queued = *sq_tail - load_acquire(sq_head);
+    }
+}
+
+void direct_io_ring::reap_locked() {
+    unsigned head = *cq_head;
+    const unsigned tail = load_acquire(cq_tail);
+    for (; head != tail; head++) {
+        const io_uring_cqe* cqe = static_cast<const io_uring_cqe*>(cqes) + (head & *cq_mask);
+        direct_io_op* op = reinterpret_cast<direct_io_op*>(uintptr_t(cqe->user_data));
+        op->result = cqe->res;
+        op->done = true;
+        in_flight--;
+    }
+    store_release(cq_head, head);
+}
+
+void direct_io_ring::wait(direct_io_op& op) {
+    std::unique_lock<std::mutex> lock(mutex);
+    submit_locked();
+    reap_locked();
+    // Leader/follower: one thread blocks in the kernel and reaps for everyone, the others wait for it
+    while (!op.done) {
+        if (reaping) {
+            reaped.wait(lock);
+            continue;
+        }
+        reaping = true;
+        lock.unlock();
+        enter(0, 1, IORING_ENTER_GETEVENTS);
+        lock.lock();
+        reaping = false;
+        reap_locked();
+        reaped.notify_all();
+    }
+}
+
+namespace {
+
+// Fills 4 KiB-aligned chunks and writes each at its offset as soon as it is full, keeping up to chunk_count
+// of them in flight. The last chunk is padded to the block size for O_DIRECT and the file truncated back.
+class direct_backend : public file_backend {
+public:
+    static constexpr size_t alignment = 4096;
+    static constexpr size_t chunk_size = size_t(256) << 10;
+    static constexpr size_t chunk_count = 4;
+
+    direct_backend(const file_options& options)
+        : options(options), ring(direct_io_ring::shared()) {
+    }
+    ~direct_backend() override {
+        if (fd >= 0) {
+            close();
+        }
+        for (char* chunk : chunks) {
+            ::operator delete(chunk, std::align_val_t(alignment));
+        }
+    }
+
+    bool open(const std::string& path, uint64_t expected_size) override {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_DIRECT, 0644);
+        if (fd < 0 && errno == EINVAL) {
+            // tmpfs and friends, which may have created the file before refusing O_DIRECT: it is ours either way
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+        if (fd < 0) {
+            return false;
+        }
+        if (chunks[0] == nullptr) {
+            for (char*& chunk : chunks) {
+                chunk = static_cast<char*>(::operator new(chunk_size, std::align_val_t(alignment)));
+            }
+        }
+        current = 0;
+        fill = 0;
+        offset = 0;
+        failed = false;
+        if (options.preallocate && expected_size > 0) {
+            (void)fallocate(fd, 0, 0, off_t(expected_size));
+        }
+        return true;
+    }
+
+    bool write(const write_segment* segments, size_t count) override {
+        if (fd < 0 || failed) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const char* data = static_cast<const char*>(segments[i].data);
+            size_t left = segments[i].size;
+            while (left > 0) {
+                const size_t n = std::min(left, chunk_size - fill);
+                memcpy(chunks[current] + fill, data, n);
+                fill += n;
+                data += n;
+                left -= n;
+                if (fill == chunk_size) {
+                    write_chunk(chunk_size);
+                }
+            }
+        }
+        if (ring.available()) {
+            ring.submit();
+        }
+        return !failed;
+    }
+
+    bool close() override {
+        if (fd < 0) {
+            return false;
+        }
+        const uint64_t size = offset + fill;
+        if (fill > 0) {
+            const size_t padded = (fill + alignment - 1) / alignment * alignment;
+            memset(chunks[current] + fill, 0, padded - fill);
+            write_chunk(padded);
+        }
+        for (size_t i = 0; i < chunk_count; i++) {
+            finish(i);
+        }
+        bool ok = !failed;
+        if (offset != size) {
+            ok &= ftruncate(fd, off_t(size)) == 0;
+        }
+        ok &= ::close(fd) == 0;
+        fd = -1;
+        return ok;
+    }
+
+    bool is_open() const override { return fd >= 0; }
+
+private:
+    void write_chunk(size_t size) {
+        if (ring.available()) {
+            ring.write(fd, chunks[current], size, offset, ops[current]);
+            sizes[current] = size;
+            offsets[current] = offset;
+        }
+        else {
+            write_sync(chunks[current], size, offset);
+        }
+        offset += size;
+        fill = 0;
+        current = (current + 1) % chunk_count;
+        finish(current);  // about to be refilled
+    }
+
+    void finish(size_t i) {
+        if (sizes[i] == 0) {
+            return;  // nothing in flight
+        }
+        ring.wait(ops[i]);
+        const size_t size = sizes[i];
+        sizes[i] = 0;
+        if (ops[i].result < 0) {
+            failed = true;
+        }
+        else if (size_t(ops[i].result) < size) {
+            // Short write: the rest goes synchronously
+            const size_t done = size_t(ops[i].result);
+            write_sync(chunks[i] + done, size - done, offsets[i] + done);
+        }
+    }
+
+    void write_sync(const char* data, size_t size, uint64_t at) {
+        while (size > 0 && !failed) {
+            const ssize_t n = pwrite(fd, data, size, off_t(at));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                failed = true;
+                return;
+            }
+            data += n;
+            size -= size_t(n);
+            at += uint64_t(n);
+        }
+    }
+
+    file_options options;
+    direct_io_ring& ring;
+    int fd = -1;
+    bool failed = false;
+    char* chunks[chunk_count] = {};
+    direct_io_op ops[chunk_count];
+    size_t sizes[chunk_count] = {};       // bytes in flight per chunk, 0 when idle
+    uint64_t offsets[chunk_count] = {};
+    size_t current = 0;
+    size_t fill = 0;
+    uint64_t offset = 0;  // file offset of the current chunk
+};
+
+} // namespace
+
+std::unique_ptr<file_backend> make_direct_backend(const file_options& options) {
+    return std::make_unique<direct_backend>(options);
+}
+#endif
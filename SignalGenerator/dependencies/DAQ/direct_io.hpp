@@ -0,0 +1,68 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include "file_backend.hpp"
+
+// One write queued on a direct_io_ring; done and result are guarded by the ring
+struct direct_io_op {
+    bool done = true;
+    int64_t result = 0;  // bytes written, or -errno
+};
+
+// An io_uring shared by every direct file of the process, set up with raw system calls (no liburing), so the
+// writes of many streams go to the kernel in the same io_uring_enter calls. Writes are queued by write() and
+// handed to the kernel by submit(), or by whoever waits first. Waiting threads take turns reaping
+// completions. Where io_uring is missing or not permitted, available() is false and direct files use pwrite.
+class direct_io_ring {
+public:
+    explicit direct_io_ring(unsigned entries = 256);
+    ~direct_io_ring();
+    direct_io_ring(const direct_io_ring&) = delete;
+    direct_io_ring& operator=(const direct_io_ring&) = delete;
+
+    // The ring direct files use
+    static direct_io_ring& shared();
+
+    bool available() const { return ring_fd >= 0; }
+    // Queues a write of size bytes at offset; buffer must stay untouched until op is done
+    void write(int fd, const void* buffer, size_t size, uint64_t offset, direct_io_op& op);
+    // Hands queued writes to the kernel without waiting
+    void submit();
+    void wait(direct_io_op& op);
+
+private:
+    void enter(unsigned to_submit, unsigned min_complete, unsigned flags);
+    void submit_locked();
+    void reap_locked();
+
+    int ring_fd = -1;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    void* sqe_memory = nullptr;
+    size_t sqe_memory_size = 0;
+    unsigned sq_entries = 0;
+    unsigned cq_entries = 0;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    void* cqes = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable reaped;
+    unsigned queued = 0;     // in the SQ ring, not yet submitted
+    unsigned in_flight = 0;  // submitted or queued, completion not reaped
+    bool reaping = false;    // a thread is blocked in io_uring_enter waiting for completions
+};
+
+// file_backend writing with O_DIRECT from 4 KiB-aligned buffers through direct_io_ring::shared(), or pwrite when
+// the ring is unavailable. Falls back to buffered writes on file systems that refuse O_DIRECT.
+std::unique_ptr<file_backend> make_direct_backend(const file_options& options);
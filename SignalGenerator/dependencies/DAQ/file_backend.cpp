@@ -0,0 +1,376 @@
+#include <fstream>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include "file_backend.hpp"
+#include "direct_io.hpp"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <climits>
+#include <cerrno>
+#include <vector>
+#endif
+
+namespace {
+
+class stream_backend : public file_backend {
+public:
+    bool open(const std::string& path, uint64_t) override {
+        output.open(path, std::ios::binary | std::ios::trunc | std::ios::out);
+        return output.is_open();
+    }
+    bool write(const write_segment* segments, size_t count) override {
+        for (size_t i = 0; i < count; i++) {
+            output.write(static_cast<const char*>(segments[i].data), std::streamsize(segments[i].size));
+        }
+        return !output.fail();
+    }
+    bool close() override {
+        output.close();
+        return !output.fail();
+    }
+    bool is_open() const override { return output.is_open(); }
+
+private:
+    std::ofstream output;
+};
+
+#ifndef _WIN32
+// Small writes (the header, the trailer) collect in a page-aligned buffer; a write that does not fit goes
+// out with whatever is buffered in one writev, without copying the large segments.
+class posix_backend : public file_backend {
+public:
+    static constexpr size_t buffer_size = size_t(1) << 20;
+    static constexpr size_t buffer_alignment = 4096;
+
+    posix_backend(bool preallocate)
+        : preallocate(preallocate) {
+    }
+    ~posix_backend() override {
+        if (fd >= 0) {
+            close();
+        }
+        ::operator delete(buffer, std::align_val_t(buffer_alignment));
+    }
+
+    bool open(const std::string& path, uint64_t expected_size) override {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (buffer == nullptr) {
+            buffer = static_cast<char*>(::operator new(buffer_size, std::align_val_t(buffer_alignment)));
+        }
+        fill = 0;
+        failed = false;
+#ifdef __linux__
+        if (preallocate && expected_size > 0) {
+            // Best effort: not every file system supports it, and the writes work either way
+            (void)fallocate(fd, 0, 0, off_t(expected_size));
+        }
+#else
+        (void)expected_size;
+#endif
+        return true;
+    }
+
+    bool write(const write_segment* segments, size_t count) override {
+        if (fd < 0 || failed) {
+            return false;
+        }
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            total += segments[i].size;
+        }
+        if (fill + total <= buffer_size) {
+            for (size_t i = 0; i < count; i++) {
+                if (segments[i].size > 0) {
+                    memcpy(buffer + fill, segments[i].data, segments[i].size);
+                    fill += segments[i].size;
+                }
+            }
+            return true;
+        }
+        iov.clear();
+        if (fill > 0) {
+            iov.push_back({ buffer, fill });
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (segments[i].size > 0) {
+                iov.push_back({ const_cast<void*>(segments[i].data), segments[i].size });
+            }
+        }
+        fill = 0;
+        return write_all();
+    }
+
+    bool close() override {
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = !failed;
+        if (ok && fill > 0) {
+            iov.clear();
+            iov.push_back({ buffer, fill });
+            ok = write_all();
+        }
+        fill = 0;
+        ok &= ::close(fd) == 0;
+        fd = -1;
+        return ok;
+    }
+
+    bool is_open() const override { return fd >= 0; }
+
+private:
+    // writev until everything in iov is written, across short writes, EINTR and IOV_MAX
+    bool write_all() {
+        size_t first = 0;
+        while (first < iov.size()) {
+            const int n = int(std::min<size_t>(iov.size() - first, IOV_MAX));
+            const ssize_t written = ::writev(fd, &iov[first], n);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                failed = true;
+                return false;
+            }
+            size_t left = size_t(written);
+            while (first < iov.size() && left >= iov[first].iov_len) {
+                left -= iov[first].iov_len;
+                first++;
+            }
+            if (left > 0) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+                iov[first].iov_len -= left;
+            }
+        }
+        return true;
+    }
+
+    bool preallocate;
+    int fd = -1;
+    bool failed = false;
+    char* buffer = nullptr;
+    size_t fill = 0;
+    std::vector<iovec> iov;
+};
+
+// Sizes the file to the expected size, maps it and copies writes into the mapping. Without an expected size
+// it hands everything to a posix_backend instead.
+class mmap_backend : public file_backend {
+public:
+    mmap_backend(const file_options& options)
+        : options(options) {
+    }
+    ~mmap_backend() override {
+        if (is_open()) {
+            close();
+        }
+    }
+
+    bool open(const std::string& path, uint64_t expected_size) override {
+        if (expected_size == 0) {
+            fallback = std::make_unique<posix_backend>(options.preallocate);
+            return fallback->open(path, 0);
+        }
+        fallback.reset();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        bool sized = false;
+#ifdef __linux__
+        sized = options.preallocate && fallocate(fd, 0, 0, off_t(expected_size)) == 0;
+#endif
+        if (!sized && ftruncate(fd, off_t(expected_size)) != 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        void* mapped = mmap(nullptr, size_t(expected_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        base = static_cast<char*>(mapped);
+        size = size_t(expected_size);
+        position = 0;
+        return true;
+    }
+
+    bool write(const write_segment* segments, size_t count) override {
+        if (fallback) {
+            return fallback->write(segments, count);
+        }
+        for (size_t i = 0; i < count; i++) {
+            void* out = map_next(segments[i].size);
+            if (out == nullptr) {
+                return false;  // past the size given to open()
+            }
+            memcpy(out, segments[i].data, segments[i].size);
+        }
+        return true;
+    }
+
+    void* map_next(size_t bytes) override {
+        if (fallback || base == nullptr || position + bytes > size) {
+            return nullptr;
+        }
+        void* out = base + position;
+        position += bytes;
+        return out;
+    }
+
+    bool close() override {
+        if (fallback) {
+            return fallback->close();
+        }
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = true;
+        if (options.msync != msync_policy::none) {
+            ok &= msync(base, size, options.msync == msync_policy::sync ? MS_SYNC : MS_ASYNC) == 0;
+        }
+        ok &= munmap(base, size) == 0;
+        base = nullptr;
+        if (position < size) {
+            ok &= ftruncate(fd, off_t(position)) == 0;  // fewer bytes than announced
+        }
+        ok &= ::close(fd) == 0;
+        fd = -1;
+        return ok;
+    }
+
+    bool is_open() const override { return fallback ? fallback->is_open() : fd >= 0; }
+
+private:
+    file_options options;
+    std::unique_ptr<posix_backend> fallback;
+    int fd = -1;
+    char* base = nullptr;
+    size_t size = 0;
+    size_t position = 0;
+};
+#endif
+
+} // namespace
+
+std::unique_ptr<file_backend> make_file_backend(const file_options& options) {
+#ifndef _WIN32
+#ifdef __linux__
+    if (options.backend == file_backend_kind::direct) {
+        return make_direct_backend(options);
+    }
+#endif
+    if (options.backend == file_backend_kind::posix || options.backend == file_backend_kind::direct) {
+        return std::make_unique<posix_backend>(options.preallocate);
+    }
+    if (options.backend == file_backend_kind::mmap) {
+        return std::make_unique<mmap_backend>(options);
+    }
+#endif
+    return std::make_unique<stream_backend>();
+}
+
+const char* file_backend_name(file_backend_kind kind) {
+    switch (kind) {
+    case file_backend_kind::stream: return "stream";
+    case file_backend_kind::posix: return "posix";
+    case file_backend_kind::mmap: return "mmap";
+    case file_backend_kind::direct: return "direct";
+    }
+    return "?";
+}
+
+bool parse_file_backend(const std::string& name, file_backend_kind& kind) {
+    for (file_backend_kind k : { file_backend_kind::stream, file_backend_kind::posix, file_backend_kind::mmap, file_backend_kind::direct }) {
+        if (name == file_backend_name(k)) {
+            kind = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* msync_policy_name(msync_policy policy) {
+    switch (policy) {
+    case msync_policy::none: return "none";
+    case msync_policy::async: return "async";
+    case msync_policy::sync: return "sync";
+    }
+    return "?";
+}
+
+bool parse_msync_policy(const std::string& name, msync_policy& policy) {
+    for (msync_policy p : { msync_policy::none, msync_policy::async, msync_policy::sync }) {
+        if (name == msync_policy_name(p)) {
+            policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* fsync_policy_name(fsync_policy policy) {
+    switch (policy) {
+    case fsync_policy::none: return "none";
+    case fsync_policy::file: return "file";
+    case fsync_policy::group: return "group";
+    }
+    return "?";
+}
+
+bool parse_fsync_policy(const std::string& name, fsync_policy& policy) {
+    for (fsync_policy p : { fsync_policy::none, fsync_policy::file, fsync_policy::group }) {
+        if (name == fsync_policy_name(p)) {
+            policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* sample_layout_name(sample_layout layout) {
+    switch (layout) {
+    case sample_layout::planar: return "planar";
+    case sample_layout::interleaved: return "interleaved";
+    }
+    return "?";
+}
+
+bool parse_sample_layout(const std::string& name, sample_layout& layout) {
+    for (sample_layout l : { sample_layout::planar, sample_layout::interleaved }) {
+        if (name == sample_layout_name(l)) {
+            layout = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* sample_encoding_name(sample_encoding encoding) {
+    switch (encoding) {
+    case sample_encoding::float64: return "float64";
+    case sample_encoding::float32: return "float32";
+    case sample_encoding::int16: return "int16";
+    case sample_encoding::int24: return "int24";
+    }
+    return "?";
+}
+
+bool parse_sample_encoding(const std::string& name, sample_encoding& encoding) {
+    for (sample_encoding e : { sample_encoding::float64, sample_encoding::float32, sample_encoding::int16, sample_encoding::int24 }) {
+        if (name == sample_encoding_name(e)) {
+            encoding = e;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// How BinaryFile gets its bytes to disk
+enum class file_backend_kind {
+    stream,  // std::ofstream with its default buffer
+    posix,   // open/writev through a large aligned buffer; falls back to stream where POSIX is missing
+    mmap,    // the file is sized up front and mapped; writes are copies into the mapping. Needs the final size
+             // at open(), and behaves like posix without it.
+    direct,  // Linux: O_DIRECT from aligned buffers, queued on an io_uring shared by all files (pwrite without
+             // io_uring), so many streams do not go through the page cache. posix elsewhere.
+};
+
+// When the mmap backend pushes the mapping to disk on close()
+enum class msync_policy {
+    none,   // leave it to the kernel's writeback
+    async,  // start writeback (MS_ASYNC)
+    sync,   // wait until the data is on disk (MS_SYNC)
+};
+
+// What BinaryFile makes durable before it renames a finished file from .temp to .bin
+enum class fsync_policy {
+    none,   // rename only: the name appears atomically, the data reaches disk with the kernel's writeback
+    file,   // fsync the file, rename it, fsync its folder; every close() waits for its own flushes
+    group,  // the same, batched over the files threads close at the same time (see group_commit)
+};
+
+// Order of the samples of a multi-channel (version 4) file
+enum class sample_layout {
+    planar,       // every sample of the first channel, then of the second...
+    interleaved,  // the first sample of every channel, then the second...
+};
+
+// How each sample is stored. Integer encodings hold ADC-like counts: sample = count * scale, with the scale in
+// the header, derived from the channel's sensitivity (see encoding_scale).
+enum class sample_encoding {
+    float64,  // the generated double as is
+    float32,
+    int16,
+    int24,    // 3 bytes, little-endian
+};
+
+// Per-file write options, shared by everything that creates BinaryFiles
+struct file_options {
+    int version = 3;  // 3: one file per channel; 4: one file per acquisition with a channel table
+    sample_layout layout = sample_layout::planar;  // version 4 only
+    size_t chunk_frames = 0;  // version 4: samples per channel in each checksummed chunk; 0 writes one plain payload
+    sample_encoding encoding = sample_encoding::float64;
+    double full_scale = 10;   // integer encodings: the largest |sample| * sensitivity that fits; beyond it samples clip
+    bool compress = false;    // version 4: losslessly compress each chunk (see sample_codec); chunks by 16384
+                              // samples unless chunk_frames says otherwise
+    file_backend_kind backend = file_backend_kind::posix;
+    bool preallocate = false;  // reserve the final size up front when it is known (fallocate)
+    msync_policy msync = msync_policy::none;  // mmap backend only
+    fsync_policy fsync = fsync_policy::none;
+};
+
+// A piece of a gathered write
+struct write_segment {
+    const void* data;
+    size_t size;
+};
+
+// Sequential writer for one file. Segments passed to one write() call may be gathered into a single
+// system call, so a whole file can go out in one write.
+class file_backend {
+public:
+    virtual ~file_backend() = default;
+    // Creates path, failing if it exists (stream truncates it instead: ofstream has no exclusive open).
+    // expected_size is the final file size when known, 0 otherwise
+    virtual bool open(const std::string& path, uint64_t expected_size) = 0;
+    virtual bool write(const write_segment* segments, size_t count) = 0;
+    // The next size bytes of the file, to be filled in place, as if written; nullptr when the backend cannot
+    // map (then nothing is skipped). Only byte-aligned: copy into it with memcpy.
+    virtual void* map_next(size_t /*size*/) { return nullptr; }
+    virtual bool close() = 0;
+    virtual bool is_open() const = 0;
+};
+
+std::unique_ptr<file_backend> make_file_backend(const file_options& options);
+const char* file_backend_name(file_backend_kind kind);
+// "stream", "posix", "mmap" or "direct"; false for anything else
+bool parse_file_backend(const std::string& name, file_backend_kind& kind);
+const char* msync_policy_name(msync_policy policy);
+bool parse_msync_policy(const std::string& name, msync_policy& policy);
+const char* fsync_policy_name(fsync_policy policy);
+bool parse_fsync_policy(const std::string& name, fsync_policy& policy);
+const char* sample_layout_name(sample_layout layout);
+bool parse_sample_layout(const std::string& name, sample_layout& layout);
+const char* sample_encoding_name(sample_encoding encoding);
+bool parse_sample_encoding(const std::string& name, sample_encoding& encoding);
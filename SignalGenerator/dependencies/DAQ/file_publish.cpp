@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <filesystem>
+#include "file_publish.hpp"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE 1
+#endif
+
+namespace {
+
+std::string folder_of(const std::string& path) {
+    const std::string folder = std::filesystem::path(path).parent_path().string();
+    return folder.empty() ? "." : folder;
+}
+
+#ifdef _WIN32
+
+// Without MOVEFILE_REPLACE_EXISTING the move fails when to exists
+bool rename_file(const std::string& from, const std::string& to) {
+    return MoveFileExA(from.c_str(), to.c_str(), 0) != 0;
+}
+
+bool sync_file(const std::string& path) {
+    const int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = _commit(fd) == 0;
+    _close(fd);
+    return ok;
+}
+
+// NTFS journals the rename itself; there is no folder to flush
+bool sync_folder(const std::string&) {
+    return true;
+}
+
+#else
+
+// Fails when to exists. renameat2() does that in one step; where the kernel or the file system lacks it, link()
+// fails the same way and the temporary name goes afterwards.
+bool rename_file(const std::string& from, const std::string& to) {
+#if defined(__linux__) && defined(SYS_renameat2)
+    if (syscall(SYS_renameat2, AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_NOREPLACE) == 0) {
+        return true;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        return false;
+    }
+#endif
+    if (link(from.c_str(), to.c_str()) != 0) {
+        return false;
+    }
+    // Published either way; a leftover temporary name is only a second link to the same file
+    unlink(from.c_str());
+    return true;
+}
+
+bool sync_file(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// Makes the renames in the folder durable
+bool sync_folder(const std::string& folder) {
+    const int fd = ::open(folder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+#endif
+
+}  // namespace
+
+bool publish_file(const std::string& temp_path, const std::string& final_path, fsync_policy policy) {
+    switch (policy) {
+    case fsync_policy::none:
+        return rename_file(temp_path, final_path);
+    case fsync_policy::file:
+        return sync_file(temp_path) && rename_file(temp_path, final_path) && sync_folder(folder_of(final_path));
+    case fsync_policy::group:
+        return group_commit::shared().commit(temp_path, final_path);
+    }
+    return false;
+}
+
+group_commit& group_commit::shared() {
+    static group_commit commit;
+    return commit;
+}
+
+bool group_commit::commit(const std::string& temp_path, const std::string& final_path) {
+    entry mine;
+    mine.temp_path = temp_path;
+    mine.final_path = final_path;
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.push_back(&mine);
+    while (!mine.done) {
+        if (committing) {
+            committed.wait(lock);
+            continue;
+        }
+        // Commit everything queued so far, this file included
+        committing = true;
+        std::vector<entry*> batch;
+        batch.swap(queue);
+        lock.unlock();
+        commit_batch(batch);
+        lock.lock();
+        for (entry* e : batch) {
+            e->done = true;
+        }
+        totals.files += batch.size();
+        totals.batches++;
+        committing = false;
+        committed.notify_all();
+    }
+    return mine.ok;
+}
+
+void group_commit::commit_batch(const std::vector<entry*>& batch) {
+#ifdef _WIN32
+    for (entry* e : batch) {
+        e->ok = sync_file(e->temp_path);
+    }
+#else
+    // Writeback of every file starts first, so each fsync mostly waits for I/O already under way
+    std::vector<int> fds(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        fds[i] = ::open(batch[i]->temp_path.c_str(), O_RDONLY | O_CLOEXEC);
+#ifdef __linux__
+        if (fds[i] >= 0) {
+            (void)sync_file_range(fds[i], 0, 0, SYNC_FILE_RANGE_WRITE);
+        }
+#endif
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+        batch[i]->ok = fds[i] >= 0 && fsync(fds[i]) == 0;
+        if (fds[i] >= 0) {
+            ::close(fds[i]);
+        }
+    }
+#endif
+    std::vector<std::string> folders;
+    for (entry* e : batch) {
+        e->ok = e->ok && rename_file(e->temp_path, e->final_path);
+        const std::string folder = folder_of(e->final_path);
+        if (e->ok && std::find(folders.begin(), folders.end(), folder) == folders.end()) {
+            folders.push_back(folder);
+        }
+    }
+    // Each folder once, however many of the batch's files went into it
+    for (const std::string& folder : folders) {
+        if (!sync_folder(folder)) {
+            for (entry* e : batch) {
+                e->ok = e->ok && folder_of(e->final_path) != folder;
+            }
+        }
+    }
+}
+
+group_commit::statistics group_commit::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "file_backend.hpp"
+
+// A finished file is written under a temporary name and renamed to its final one, so whoever watches the folder
+// sees only complete files: the final name never points at part of a file. The rename never replaces a file
+// already published under the final name.
+
+// Renames temp_path to final_path after making the data durable as policy says; false when a sync or the rename
+// fails, final_path existing already included (a final_path of this call's exists only if the file was renamed
+// before its folder failed to sync)
+bool publish_file(const std::string& temp_path, const std::string& final_path, fsync_policy policy);
+
+// Group commit of the files several threads publish at the same time. A thread that finds no commit running
+// takes every queued file, starts writeback of all of them, fsyncs them, renames them and fsyncs each of their
+// folders once; threads arriving meanwhile queue their files for the next round and wait for it.
+class group_commit {
+public:
+    struct statistics {
+        uint64_t files = 0;
+        uint64_t batches = 0;
+    };
+
+    // The group commit fsync_policy::group files go through
+    static group_commit& shared();
+
+    bool commit(const std::string& temp_path, const std::string& final_path);
+    statistics stats() const;
+
+private:
+    struct entry {
+        std::string temp_path;
+        std::string final_path;
+        bool done = false;
+        bool ok = false;
+    };
+    void commit_batch(const std::vector<entry*>& batch);
+
+    mutable std::mutex mutex;
+    std::condition_variable committed;
+    std::vector<entry*> queue;
+    bool committing = false;
+    statistics totals;
+};
@@ -0,0 +1,363 @@
+#include <bit>
+#include <cstring>
+#include <algorithm>
+#include "sample_codec.hpp"
+#include "sample_encoding.hpp"
+#include "signal_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CODEC_X86 1
+#include <immintrin.h>
+#endif
+
+// MSVC compiles any intrinsic anywhere; GCC and Clang need the instruction set enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CODEC_TARGET(isa)
+#else
+#define CODEC_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace {
+
+const size_t BLOCK = 256;        // residuals per block
+const size_t ROW_BYTES = 32;     // one 256-bit row: 8 lanes of 32 bits or 4 of 64
+const unsigned char SECOND_DIFFERENCE = 0x80;
+
+template <typename Word>
+constexpr int word_bits() {
+    return int(sizeof(Word) * 8);
+}
+
+template <typename Word>
+constexpr size_t lane_count() {
+    return ROW_BYTES / sizeof(Word);
+}
+
+// Residual i of the block goes to lane i % lanes, at bit (i / lanes) * width of that lane's words; lane k's word j
+// is word j * lanes + k of the block. width rows of words, width * 32 bytes.
+template <typename Word>
+void pack_block(const Word* values, int width, unsigned char* out) {
+    constexpr int B = word_bits<Word>();
+    constexpr size_t L = lane_count<Word>();
+    Word words[BLOCK] = {};
+    for (size_t row = 0; row < BLOCK / L; row++) {
+        const size_t bit = row * size_t(width);
+        const size_t j = bit / B;
+        const int shift = int(bit % B);
+        for (size_t k = 0; k < L; k++) {
+            const Word v = values[row * L + k];
+            words[j * L + k] |= Word(v << shift);
+            if (shift + width > B) {
+                words[(j + 1) * L + k] |= Word(v >> (B - shift));
+            }
+        }
+    }
+    memcpy(out, words, size_t(width) * ROW_BYTES);
+}
+
+template <typename Word>
+void unpack_block_scalar(const unsigned char* in, int width, Word* values) {
+    constexpr int B = word_bits<Word>();
+    constexpr size_t L = lane_count<Word>();
+    if (width == 0) {
+        std::fill(values, values + BLOCK, Word(0));
+        return;
+    }
+    const Word mask = width == B ? Word(~Word(0)) : Word((Word(1) << width) - 1);
+    for (size_t row = 0; row < BLOCK / L; row++) {
+        const size_t bit = row * size_t(width);
+        const size_t j = bit / B;
+        const int shift = int(bit % B);
+        for (size_t k = 0; k < L; k++) {
+            Word low;
+            memcpy(&low, in + (j * L + k) * sizeof(Word), sizeof(Word));
+            Word v = Word(low >> shift);
+            if (shift + width > B) {
+                Word high;
+                memcpy(&high, in + ((j + 1) * L + k) * sizeof(Word), sizeof(Word));
+                v |= Word(high << (B - shift));
+            }
+            values[row * L + k] = v & mask;
+        }
+    }
+}
+
+#ifdef CODEC_X86
+
+// Every lane of a row sits at the same bit offset, so a row is one shift pair and a mask
+CODEC_TARGET("avx2")
+void unpack_block32_avx2(const unsigned char* in, int width, uint32_t* values) {
+    if (width == 0) {
+        std::fill(values, values + BLOCK, 0u);
+        return;
+    }
+    const __m256i mask = _mm256_set1_epi32(width == 32 ? -1 : int((1u << width) - 1));
+    for (size_t row = 0; row < BLOCK / 8; row++) {
+        const size_t bit = row * size_t(width);
+        const size_t j = bit / 32;
+        const int shift = int(bit % 32);
+        __m256i v = _mm256_srl_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + j * ROW_BYTES)), _mm_cvtsi32_si128(shift));
+        if (shift + width > 32) {
+            const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + (j + 1) * ROW_BYTES));
+            v = _mm256_or_si256(v, _mm256_sll_epi32(high, _mm_cvtsi32_si128(32 - shift)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + row * 8), _mm256_and_si256(v, mask));
+    }
+}
+
+CODEC_TARGET("avx2")
+void unpack_block64_avx2(const unsigned char* in, int width, uint64_t* values) {
+    if (width == 0) {
+        std::fill(values, values + BLOCK, uint64_t(0));
+        return;
+    }
+    const __m256i mask = _mm256_set1_epi64x(width == 64 ? -1 : (long long)((uint64_t(1) << width) - 1));
+    for (size_t row = 0; row < BLOCK / 4; row++) {
+        const size_t bit = row * size_t(width);
+        const size_t j = bit / 64;
+        const int shift = int(bit % 64);
+        __m256i v = _mm256_srl_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + j * ROW_BYTES)), _mm_cvtsi32_si128(shift));
+        if (shift + width > 64) {
+            const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + (j + 1) * ROW_BYTES));
+            v = _mm256_or_si256(v, _mm256_sll_epi64(high, _mm_cvtsi32_si128(64 - shift)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + row * 4), _mm256_and_si256(v, mask));
+    }
+}
+
+#endif
+
+using unpack32_kernel = void (*)(const unsigned char*, int, uint32_t*);
+using unpack64_kernel = void (*)(const unsigned char*, int, uint64_t*);
+
+struct unpack_kernels {
+    unpack32_kernel unpack32;
+    unpack64_kernel unpack64;
+    const char* name;
+};
+
+unpack_kernels select_kernels() {
+#ifdef CODEC_X86
+    if (detected_simd_level() >= simd_level::avx2) {
+        return { unpack_block32_avx2, unpack_block64_avx2, "AVX2" };
+    }
+#endif
+    return { unpack_block_scalar<uint32_t>, unpack_block_scalar<uint64_t>, "scalar" };
+}
+
+const unpack_kernels KERNELS = select_kernels();
+
+void unpack_block(const unsigned char* in, int width, uint32_t* values) {
+    KERNELS.unpack32(in, width, values);
+}
+
+void unpack_block(const unsigned char* in, int width, uint64_t* values) {
+    KERNELS.unpack64(in, width, values);
+}
+
+uint32_t zigzag(int64_t d) {
+    return uint32_t((d << 1) ^ (d >> 63));
+}
+
+int32_t unzigzag(uint32_t z) {
+    return int32_t((z >> 1) ^ (0u - (z & 1)));
+}
+
+// Stored samples as words: integer counts sign-extended, floats as their bits
+template <typename Word>
+std::vector<Word> load_words(sample_encoding encoding, const unsigned char* in, size_t n) {
+    std::vector<Word> words(n);
+    for (size_t i = 0; i < n; i++) {
+        if (encoding == sample_encoding::int16) {
+            int16_t c;
+            memcpy(&c, in + 2 * i, 2);
+            words[i] = Word(uint32_t(int32_t(c)));
+        }
+        else if (encoding == sample_encoding::int24) {
+            const uint32_t c = uint32_t(in[3 * i]) | uint32_t(in[3 * i + 1]) << 8 | uint32_t(in[3 * i + 2]) << 16;
+            words[i] = Word(uint32_t(int32_t(c << 8) >> 8));
+        }
+        else {
+            memcpy(&words[i], in + sizeof(Word) * i, sizeof(Word));
+        }
+    }
+    return words;
+}
+
+template <typename Word>
+void store_word(sample_encoding encoding, Word word, unsigned char* out, size_t i) {
+    if (encoding == sample_encoding::int16) {
+        const uint16_t c = uint16_t(word);
+        memcpy(out + 2 * i, &c, 2);
+    }
+    else if (encoding == sample_encoding::int24) {
+        out[3 * i] = (unsigned char)word;
+        out[3 * i + 1] = (unsigned char)(word >> 8);
+        out[3 * i + 2] = (unsigned char)(word >> 16);
+    }
+    else {
+        memcpy(out + sizeof(Word) * i, &word, sizeof(Word));
+    }
+}
+
+template <typename Word>
+void compress_xor(const std::vector<Word>& words, std::vector<unsigned char>& out) {
+    Word previous = 0;
+    Word residuals[BLOCK];
+    for (size_t first = 0; first < words.size(); first += BLOCK) {
+        const size_t m = std::min(BLOCK, words.size() - first);
+        Word any = 0;
+        for (size_t i = 0; i < m; i++) {
+            residuals[i] = words[first + i] ^ previous;
+            previous = words[first + i];
+            any |= residuals[i];
+        }
+        std::fill(residuals + m, residuals + BLOCK, Word(0));
+        // Trailing zero bits every residual has are dropped; the high ones are cut by the width
+        const int shift = any == 0 ? 0 : std::countr_zero(any);
+        const int width = int(std::bit_width(any)) - shift;
+        for (size_t i = 0; i < m; i++) {
+            residuals[i] >>= shift;
+        }
+        const size_t at = out.size();
+        out.resize(at + 2 + size_t(width) * ROW_BYTES);
+        out[at] = (unsigned char)width;
+        out[at + 1] = (unsigned char)shift;
+        pack_block(residuals, width, out.data() + at + 2);
+    }
+}
+
+void compress_counts(const std::vector<uint32_t>& counts, std::vector<unsigned char>& out) {
+    int64_t previous = 0;
+    int64_t previous_delta = 0;
+    uint32_t first_order[BLOCK];
+    uint32_t second_order[BLOCK];
+    for (size_t first = 0; first < counts.size(); first += BLOCK) {
+        const size_t m = std::min(BLOCK, counts.size() - first);
+        uint32_t any_first = 0;
+        uint32_t any_second = 0;
+        for (size_t i = 0; i < m; i++) {
+            const int64_t count = int32_t(counts[first + i]);
+            const int64_t delta = count - previous;
+            first_order[i] = zigzag(delta);
+            second_order[i] = zigzag(delta - previous_delta);
+            any_first |= first_order[i];
+            any_second |= second_order[i];
+            previous = count;
+            previous_delta = delta;
+        }
+        std::fill(first_order + m, first_order + BLOCK, 0u);
+        std::fill(second_order + m, second_order + BLOCK, 0u);
+        const int width_first = int(std::bit_width(any_first));
+        const int width_second = int(std::bit_width(any_second));
+        const bool second = width_second < width_first;
+        const int width = second ? width_second : width_first;
+        const size_t at = out.size();
+        out.resize(at + 2 + size_t(width) * ROW_BYTES);
+        out[at] = (unsigned char)(width | (second ? SECOND_DIFFERENCE : 0));
+        out[at + 1] = 0;
+        pack_block(second ? second_order : first_order, width, out.data() + at + 2);
+    }
+}
+
+template <typename Word>
+bool decompress_xor(sample_encoding encoding, const unsigned char* in, size_t size, size_t n, unsigned char* out) {
+    Word previous = 0;
+    alignas(32) Word residuals[BLOCK];
+    size_t at = 0;
+    for (size_t first = 0; first < n; first += BLOCK) {
+        if (at + 2 > size) {
+            return false;
+        }
+        const int width = in[at];
+        const int shift = in[at + 1];
+        if (width + shift > word_bits<Word>() || at + 2 + size_t(width) * ROW_BYTES > size) {
+            return false;
+        }
+        unpack_block(in + at + 2, width, residuals);
+        at += 2 + size_t(width) * ROW_BYTES;
+        const size_t m = std::min(BLOCK, n - first);
+        for (size_t i = 0; i < m; i++) {
+            previous ^= Word(residuals[i] << shift);
+            store_word(encoding, previous, out, first + i);
+        }
+    }
+    return at == size;
+}
+
+bool decompress_counts(sample_encoding encoding, const unsigned char* in, size_t size, size_t n, unsigned char* out) {
+    uint32_t previous = 0;
+    uint32_t previous_delta = 0;
+    alignas(32) uint32_t residuals[BLOCK];
+    size_t at = 0;
+    for (size_t first = 0; first < n; first += BLOCK) {
+        if (at + 2 > size) {
+            return false;
+        }
+        const bool second = (in[at] & SECOND_DIFFERENCE) != 0;
+        const int width = in[at] & ~SECOND_DIFFERENCE;
+        if (width > 32 || in[at + 1] != 0 || at + 2 + size_t(width) * ROW_BYTES > size) {
+            return false;
+        }
+        unpack_block(in + at + 2, width, residuals);
+        at += 2 + size_t(width) * ROW_BYTES;
+        const size_t m = std::min(BLOCK, n - first);
+        // Wrapping arithmetic: well-formed input never wraps, malformed input must not be undefined
+        for (size_t i = 0; i < m; i++) {
+            const uint32_t r = uint32_t(unzigzag(residuals[i]));
+            const uint32_t delta = second ? previous_delta + r : r;
+            previous += delta;
+            previous_delta = delta;
+            store_word(encoding, previous, out, first + i);
+        }
+    }
+    return at == size;
+}
+
+}  // namespace
+
+sample_codec codec_for(sample_encoding encoding) {
+    return encoding == sample_encoding::int16 || encoding == sample_encoding::int24 ? sample_codec::int_delta : sample_codec::xor_delta;
+}
+
+const char* sample_codec_name(sample_codec codec) {
+    switch (codec) {
+    case sample_codec::none: return "none";
+    case sample_codec::xor_delta: return "xor";
+    case sample_codec::int_delta: return "delta";
+    }
+    return "?";
+}
+
+const char* sample_codec_kernels() {
+    return KERNELS.name;
+}
+
+size_t min_compressed_size(size_t n) {
+    // Every block has its 2-byte header, even one whose residuals are all zero
+    return 2 * ((n + BLOCK - 1) / BLOCK);
+}
+
+void compress_samples(sample_encoding encoding, const void* in, size_t n, std::vector<unsigned char>& out) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(in);
+    if (encoding == sample_encoding::float64) {
+        compress_xor(load_words<uint64_t>(encoding, bytes, n), out);
+    }
+    else if (encoding == sample_encoding::float32) {
+        compress_xor(load_words<uint32_t>(encoding, bytes, n), out);
+    }
+    else {
+        compress_counts(load_words<uint32_t>(encoding, bytes, n), out);
+    }
+}
+
+bool decompress_samples(sample_encoding encoding, const unsigned char* in, size_t size, size_t n, void* out) {
+    unsigned char* bytes = static_cast<unsigned char*>(out);
+    if (encoding == sample_encoding::float64) {
+        return decompress_xor<uint64_t>(encoding, in, size, n, bytes);
+    }
+    if (encoding == sample_encoding::float32) {
+        return decompress_xor<uint32_t>(encoding, in, size, n, bytes);
+    }
+    return decompress_counts(encoding, in, size, n, bytes);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "file_backend.hpp"
+
+// Lossless compression of the samples of one channel, as stored in a PDAT chunk (after encoding):
+//   - float64 and float32: Gorilla-style XOR of each sample with the previous one;
+//   - int16 and int24: the difference from the previous count, or the difference of differences, whichever
+//     packs smaller, zigzag mapped so small negative steps stay small.
+// Residuals are bit-packed 256 at a time at the width of the widest one (after dropping the trailing zero bits
+// every XOR shares), in a vertical layout: residual i goes to lane i % lanes of 256-bit rows, so unpacking is the
+// same shift and mask on every lane, and AVX2 unpacks a whole row at once. Each block starts with two bytes:
+// the width (bit 7 set for second differences) and the shift.
+enum class sample_codec {
+    none,
+    xor_delta,   // float encodings
+    int_delta,   // integer encodings
+};
+
+// The codec compression uses for samples stored as encoding
+sample_codec codec_for(sample_encoding encoding);
+const char* sample_codec_name(sample_codec codec);
+// The unpack kernels decompress_samples() runs on this CPU: "AVX2" or "scalar"
+const char* sample_codec_kernels();
+// Appends the compressed form of n samples stored as encoding (encoded_size(encoding) bytes each) to out
+void compress_samples(sample_encoding encoding, const void* in, size_t n, std::vector<unsigned char>& out);
+// The fewest bytes compress_samples() writes for n samples, whatever they are
+size_t min_compressed_size(size_t n);
+// Expands size bytes written by compress_samples back into n stored samples; false when they are malformed
+bool decompress_samples(sample_encoding encoding, const unsigned char* in, size_t size, size_t n, void* out);
@@ -0,0 +1,233 @@
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include "sample_encoding.hpp"
+#include "signal_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ENC_X86 1
+#include <immintrin.h>
+#endif
+
+// MSVC compiles any intrinsic anywhere; GCC and Clang need the instruction set enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define ENC_TARGET(isa)
+#else
+#define ENC_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace {
+
+const double INT16_MIN_COUNT = -32768.0;
+const double INT16_MAX_COUNT = 32767.0;
+const double INT24_MIN_COUNT = -8388608.0;
+const double INT24_MAX_COUNT = 8388607.0;
+
+// Clamps like the vector max/min below (NaN becomes lo), then rounds to nearest even like cvtpd_epi32
+int32_t to_count(double x, double lo, double hi) {
+    x = x > lo ? x : lo;
+    x = x < hi ? x : hi;
+    return int32_t(std::nearbyint(x));
+}
+
+void encode_float32_scalar(const double* in, size_t n, double, unsigned char* out) {
+    for (size_t i = 0; i < n; i++) {
+        const float f = float(in[i]);
+        memcpy(out + 4 * i, &f, 4);
+    }
+}
+
+void encode_int16_scalar(const double* in, size_t n, double inverse_scale, unsigned char* out) {
+    for (size_t i = 0; i < n; i++) {
+        const int16_t c = int16_t(to_count(in[i] * inverse_scale, INT16_MIN_COUNT, INT16_MAX_COUNT));
+        memcpy(out + 2 * i, &c, 2);
+    }
+}
+
+void encode_int24_scalar(const double* in, size_t n, double inverse_scale, unsigned char* out) {
+    for (size_t i = 0; i < n; i++) {
+        const uint32_t c = uint32_t(to_count(in[i] * inverse_scale, INT24_MIN_COUNT, INT24_MAX_COUNT));
+        out[3 * i] = (unsigned char)c;
+        out[3 * i + 1] = (unsigned char)(c >> 8);
+        out[3 * i + 2] = (unsigned char)(c >> 16);
+    }
+}
+
+void decode_float32_scalar(const unsigned char* in, size_t n, double, double* out) {
+    for (size_t i = 0; i < n; i++) {
+        float f;
+        memcpy(&f, in + 4 * i, 4);
+        out[i] = f;
+    }
+}
+
+void decode_int16_scalar(const unsigned char* in, size_t n, double scale, double* out) {
+    for (size_t i = 0; i < n; i++) {
+        int16_t c;
+        memcpy(&c, in + 2 * i, 2);
+        out[i] = double(c) * scale;
+    }
+}
+
+void decode_int24_scalar(const unsigned char* in, size_t n, double scale, double* out) {
+    for (size_t i = 0; i < n; i++) {
+        const uint32_t c = uint32_t(in[3 * i]) | uint32_t(in[3 * i + 1]) << 8 | uint32_t(in[3 * i + 2]) << 16;
+        out[i] = double(int32_t(c << 8) >> 8) * scale;
+    }
+}
+
+#ifdef ENC_X86
+
+ENC_TARGET("avx2")
+void encode_float32_avx2(const double* in, size_t n, double, unsigned char* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_ps(reinterpret_cast<float*>(out + 4 * i), _mm256_cvtpd_ps(_mm256_loadu_pd(in + i)));
+        _mm_storeu_ps(reinterpret_cast<float*>(out + 4 * i + 16), _mm256_cvtpd_ps(_mm256_loadu_pd(in + i + 4)));
+    }
+    encode_float32_scalar(in + i, n - i, 1, out + 4 * i);
+}
+
+// Four scaled, clamped counts
+ENC_TARGET("avx2")
+__m128i counts_avx2(const double* in, __m256d inverse_scale, __m256d lo, __m256d hi) {
+    const __m256d x = _mm256_mul_pd(_mm256_loadu_pd(in), inverse_scale);
+    return _mm256_cvtpd_epi32(_mm256_min_pd(_mm256_max_pd(x, lo), hi));
+}
+
+ENC_TARGET("avx2")
+void encode_int16_avx2(const double* in, size_t n, double inverse_scale, unsigned char* out) {
+    const __m256d s = _mm256_set1_pd(inverse_scale);
+    const __m256d lo = _mm256_set1_pd(INT16_MIN_COUNT);
+    const __m256d hi = _mm256_set1_pd(INT16_MAX_COUNT);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i a = counts_avx2(in + i, s, lo, hi);
+        const __m128i b = counts_avx2(in + i + 4, s, lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_packs_epi32(a, b));
+    }
+    encode_int16_scalar(in + i, n - i, inverse_scale, out + 2 * i);
+}
+
+ENC_TARGET("avx2")
+void encode_int24_avx2(const double* in, size_t n, double inverse_scale, unsigned char* out) {
+    const __m256d s = _mm256_set1_pd(inverse_scale);
+    const __m256d lo = _mm256_set1_pd(INT24_MIN_COUNT);
+    const __m256d hi = _mm256_set1_pd(INT24_MAX_COUNT);
+    // The low three bytes of each count, packed into the first 12 bytes
+    const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i packed = _mm_shuffle_epi8(counts_avx2(in + i, s, lo, hi), pack);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 3 * i), packed);
+        const int32_t last = _mm_extract_epi32(packed, 2);
+        memcpy(out + 3 * i + 8, &last, 4);
+    }
+    encode_int24_scalar(in + i, n - i, inverse_scale, out + 3 * i);
+}
+
+ENC_TARGET("avx2")
+void decode_float32_avx2(const unsigned char* in, size_t n, double, double* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm_loadu_ps(reinterpret_cast<const float*>(in + 4 * i))));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm_loadu_ps(reinterpret_cast<const float*>(in + 4 * i + 16))));
+    }
+    decode_float32_scalar(in + 4 * i, n - i, 1, out + i);
+}
+
+ENC_TARGET("avx2")
+void decode_int16_avx2(const unsigned char* in, size_t n, double scale, double* out) {
+    const __m256d s = _mm256_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i counts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+        const __m256i wide = _mm256_cvtepi16_epi32(counts);
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(wide)), s));
+        _mm256_storeu_pd(out + i + 4, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(wide, 1)), s));
+    }
+    decode_int16_scalar(in + 2 * i, n - i, scale, out + i);
+}
+
+ENC_TARGET("avx2")
+void decode_int24_avx2(const unsigned char* in, size_t n, double scale, double* out) {
+    const __m256d s = _mm256_set1_pd(scale);
+    // Each count into the top three bytes of a lane, then an arithmetic shift extends the sign
+    const __m128i unpack = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32_t last;
+        memcpy(&last, in + 3 * i + 8, 4);
+        const __m128i bytes = _mm_insert_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + 3 * i)), last, 2);
+        const __m128i counts = _mm_srai_epi32(_mm_shuffle_epi8(bytes, unpack), 8);
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_cvtepi32_pd(counts), s));
+    }
+    decode_int24_scalar(in + 3 * i, n - i, scale, out + i);
+}
+
+#endif
+
+using encode_kernel = void (*)(const double*, size_t, double, unsigned char*);
+using decode_kernel = void (*)(const unsigned char*, size_t, double, double*);
+
+struct encoding_kernels {
+    encode_kernel encode[4];
+    decode_kernel decode[4];
+};
+
+encoding_kernels select_kernels() {
+#ifdef ENC_X86
+    if (detected_simd_level() >= simd_level::avx2) {
+        return {
+            { nullptr, encode_float32_avx2, encode_int16_avx2, encode_int24_avx2 },
+            { nullptr, decode_float32_avx2, decode_int16_avx2, decode_int24_avx2 },
+        };
+    }
+#endif
+    return {
+        { nullptr, encode_float32_scalar, encode_int16_scalar, encode_int24_scalar },
+        { nullptr, decode_float32_scalar, decode_int16_scalar, decode_int24_scalar },
+    };
+}
+
+const encoding_kernels KERNELS = select_kernels();
+
+}  // namespace
+
+size_t encoded_size(sample_encoding encoding) {
+    switch (encoding) {
+    case sample_encoding::float32: return 4;
+    case sample_encoding::int16: return 2;
+    case sample_encoding::int24: return 3;
+    default: return 8;
+    }
+}
+
+double encoding_scale(sample_encoding encoding, double full_scale, int sensitivity) {
+    const double range = full_scale / double(sensitivity > 0 ? sensitivity : 1);
+    switch (encoding) {
+    case sample_encoding::int16: return range / INT16_MAX_COUNT;
+    case sample_encoding::int24: return range / INT24_MAX_COUNT;
+    default: return 1;
+    }
+}
+
+void encode_samples(sample_encoding encoding, const double* in, size_t n, double inverse_scale, void* out) {
+    if (encoding == sample_encoding::float64) {
+        if (n > 0) {
+            memcpy(out, in, n * sizeof(double));
+        }
+        return;
+    }
+    KERNELS.encode[int(encoding)](in, n, inverse_scale, static_cast<unsigned char*>(out));
+}
+
+void decode_samples(sample_encoding encoding, const void* in, size_t n, double scale, double* out) {
+    if (encoding == sample_encoding::float64) {
+        if (n > 0) {
+            memcpy(out, in, n * sizeof(double));
+        }
+        return;
+    }
+    KERNELS.decode[int(encoding)](static_cast<const unsigned char*>(in), n, scale, out);
+}
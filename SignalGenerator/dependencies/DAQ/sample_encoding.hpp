@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include "file_backend.hpp"
+
+// Conversion between generated doubles and the sample encodings of PDAT files, with AVX2 kernels where the CPU
+// has them. Integer encodings round to nearest (ties to even) and saturate; NaN becomes the most negative count.
+
+// Bytes one sample takes in a file
+size_t encoded_size(sample_encoding encoding);
+// Value of one count for a channel of the given sensitivity: full_scale / sensitivity spread over the positive
+// counts. 1 for float encodings, which are not scaled.
+double encoding_scale(sample_encoding encoding, double full_scale, int sensitivity);
+// out gets n samples of in * inverse_scale (inverse_scale is ignored by float encodings)
+void encode_samples(sample_encoding encoding, const double* in, size_t n, double inverse_scale, void* out);
+// out gets n samples of in, times scale for integer encodings
+void decode_samples(sample_encoding encoding, const void* in, size_t n, double scale, double* out);
@@ -0,0 +1,35 @@
+#include "save_signal.hpp"
+#include "binary_file.hpp"
+
+ACQCONFIG single_channel_config(int sampling_freq, int acq_duration, int acq_interval, int channel_num, int sensor_type, int daq_serial_number) {
+    ACQCONFIG config;
+    config.daq_serial_number = daq_serial_number;
+    config.acq_interval = acq_interval;
+    config.acq_duration = acq_duration;
+    config.sampling_freq = sampling_freq;
+
+    config.parse_status  = 0;
+    config.start_channel = channel_num;
+    config.channel_count = 1;
+
+    config.channels[channel_num].status = 1;
+    config.channels[channel_num].sensitivity = 1;
+    config.channels[channel_num].sensor_type = sensor_type;
+    return config;
+}
+
+void save_signal(const std::vector<double>& y, int sampling_freq, int acq_duration, int acq_interval, int channel_num, int sensor_type, int daq_serial_number, const std::string& address) {
+    //std::string address = "../../Data";
+    ACQCONFIG config = single_channel_config(sampling_freq, acq_duration, acq_interval, channel_num, sensor_type, daq_serial_number);
+    save_channel(address, config, channel_num, y);
+}
+
+int save_channel(const std::string& address, ACQCONFIG& config, int channel_num, const std::vector<double>& y, const file_options& options, thread_pool* pool, time_t acquired) {
+    BinaryFile binaryFile(address, config, channel_num, options, acquired);
+    return binaryFile.writeAll(y, pool);
+}
+
+int save_acquisition(const std::string& address, ACQCONFIG& config, const std::vector<double>& y, const file_options& options, thread_pool* pool, time_t acquired) {
+    BinaryFile binaryFile(address, config, options, acquired);
+    return binaryFile.writeAll(y, pool);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ctime>
+#include "ACQConfig.hpp"
+#include "file_backend.hpp"
+#include "thread_pool.hpp"
+
+// Configuration of a DAQ that acquires only channel_num, with sensitivity 1
+ACQCONFIG single_channel_config(int sampling_freq, int acq_duration, int acq_interval, int channel_num, int sensor_type, int daq_serial_number);
+// Writes one acquisition of a single channel to a new binary file in address
+void save_signal(const std::vector<double>& y, int sampling_freq, int acq_duration, int acq_interval, int channel_num, int sensor_type, int daq_serial_number, const std::string& address);
+// Writes one acquisition of channel_num with that channel's sensitivity and sensor type from config. With a pool,
+// compressed chunks are compressed on it. The file is named after acquired (0: now) and fails rather than
+// replace a file of the same name.
+int save_channel(const std::string& address, ACQCONFIG& config, int channel_num, const std::vector<double>& y, const file_options& options = file_options(), thread_pool* pool = nullptr, time_t acquired = 0);
+// Writes one acquisition of every channel of config whose status is 1 to one version 4 file; y holds the
+// channels planar, in channel order
+int save_acquisition(const std::string& address, ACQCONFIG& config, const std::vector<double>& y, const file_options& options = file_options(), thread_pool* pool = nullptr, time_t acquired = 0);
@@ -1,11 +1,35 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <iostream>
+#include <ctime>
 #include "utils.hpp"
 
+namespace {
+
+// localtime() shares one buffer between threads, and files are named from several writer threads at once
+tm local_time(time_t t) {
+    tm result;
+#ifdef _WIN32
+    localtime_s(&result, &t);
+#else
+    localtime_r(&t, &result);
+#endif
+    return result;
+}
+
+} // namespace
+
 // Function to get the current date and time as a string
 std::string getCurrentDateTime() {
-    time_t now = time(0);
-    tm* ltm = localtime(&now);
+    return formatDateTime(time(0));
+}
+
+std::string getCurrentDateTimeJustDash() {
+    return formatDateTimeJustDash(time(0));
+}
+
+std::string formatDateTime(time_t t) {
+    const tm local = local_time(t);
+    const tm* ltm = &local;
     char date[20];
     snprintf(date, sizeof(date), "%04d-%02d-%02d %02d:%02d:%02d",
         1900 + ltm->tm_year, 1 + ltm->tm_mon, ltm->tm_mday,
@@ -13,9 +37,9 @@ std::string getCurrentDateTime() {
     return std::string(date);
 }
 
-std::string getCurrentDateTimeJustDash() {
-    time_t now = time(0);
-    tm* ltm = localtime(&now);
+std::string formatDateTimeJustDash(time_t t) {
+    const tm local = local_time(t);
+    const tm* ltm = &local;
     char date[20];
     snprintf(date, sizeof(date), "%04d-%02d-%02d_%02d-%02d-%02d",
         1900 + ltm->tm_year, 1 + ltm->tm_mon, ltm->tm_mday,
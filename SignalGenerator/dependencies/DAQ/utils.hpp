@@ -1,3 +1,8 @@
 #pragma once
+#include <string>
+#include <ctime>
 std::string getCurrentDateTime();
-std::string getCurrentDateTimeJustDash();
\ No newline at end of file
+std::string getCurrentDateTimeJustDash();
+// The same for a given time, in local time
+std::string formatDateTime(time_t t);
+std::string formatDateTimeJustDash(time_t t);
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <iostream>
+#include "acquisition_engine.hpp"
+
+acquisition_engine::acquisition_engine(save_function save)
+    : save(std::move(save)) {
+    latest = std::make_shared<acquisition_preview>();
+    worker = std::thread([this] { run(); });
+}
+
+acquisition_engine::~acquisition_engine() {
+    scheduler.stop();
+    worker.join();
+}
+
+void acquisition_engine::publish(const acquisition_settings& settings, const std::vector<std::unique_ptr<signal>>& signals) {
+    std::vector<uint64_t> versions(signals.size());
+    for (size_t i = 0; i < signals.size(); i++) {
+        versions[i] = signals[i]->version();
+    }
+    if (published && settings == published_settings && versions == published_versions) {
+        return;
+    }
+    published = true;
+    published_settings = settings;
+    published_versions = std::move(versions);
+
+    // Clone outside the lock; the engine only ever sees its own copies
+    std::vector<std::unique_ptr<signal>> copies;
+    copies.reserve(signals.size());
+    for (const auto& s : signals) {
+        copies.push_back(s->clone());
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_settings = settings;
+        pending_signals = std::move(copies);
+        update_pending = true;
+    }
+    scheduler.wake();
+}
+
+void acquisition_engine::save_now() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        save_requested = true;
+    }
+    scheduler.wake();
+}
+
+void acquisition_engine::reset_clock() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reset_requested = true;
+    }
+    scheduler.wake();
+}
+
+std::shared_ptr<const acquisition_preview> acquisition_engine::preview() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return latest;
+}
+
+lateness_histogram acquisition_engine::save_lateness() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lateness;
+}
+
+uint64_t acquisition_engine::skipped_saves() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return skipped;
+}
+
+// Starts a new periodic series; timers still pending from the old one are ignored when they fire
+void acquisition_engine::schedule_saves(clock_type::time_point first) {
+    series++;
+    if (settings.periodic) {
+        scheduler.add(first, series);
+    }
+}
+
+void acquisition_engine::run() {
+    if (!scheduler.valid()) {
+        std::cerr << "Error starting the acquisition engine: " << scheduler.error() << "; nothing will be saved\n";
+        return;
+    }
+    bool configured = false;  // nothing is generated or saved before the first publish()
+    std::vector<acquisition_scheduler::timer> fired;
+    while (scheduler.wait(fired)) {
+        bool update, save_request, reset;
+        const acquisition_settings previous = settings;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            update = update_pending;
+            save_request = save_requested;
+            reset = reset_requested;
+            if (update) {
+                settings = pending_settings;
+                signals = std::move(pending_signals);
+                pending_signals.clear();
+            }
+            update_pending = save_requested = reset_requested = false;
+        }
+        if (update && (!configured || settings.periodic != previous.periodic || settings.interval != previous.interval)) {
+            schedule_saves(clock_type::now() + std::chrono::seconds(settings.interval));
+        }
+        configured |= update;
+        if (reset) {
+            clock.reset();
+        }
+        if (!configured) {
+            fired.clear();
+            continue;
+        }
+        generate_preview();
+        if (save_request) {
+            save(settings, mixer.sum);
+        }
+        for (const auto& t : fired) {
+            if (t.id != series) {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                lateness.record(std::chrono::duration<double, std::micro>(clock_type::now() - t.deadline).count());
+            }
+            save(settings, mixer.sum);
+            clock.advance(settings.interval);
+            generate_preview();
+            // Next deadline from this one, not from now; deadlines a slow save has already passed are skipped
+            const auto interval = std::chrono::seconds(std::max(settings.interval, 1));
+            clock_type::time_point next = t.deadline + interval;
+            const clock_type::time_point now = clock_type::now();
+            if (next <= now) {
+                const auto missed = (now - next) / interval + 1;
+                next += interval * missed;
+                std::lock_guard<std::mutex> lock(mutex);
+                skipped += uint64_t(missed);
+            }
+            scheduler.add(next, series);
+        }
+        fired.clear();
+    }
+}
+
+// Brings the mixer up to date with the clock, settings and signals, and publishes a new snapshot if the
+// samples changed
+void acquisition_engine::generate_preview() {
+    sample_block block;
+    block.sampling_freq = settings.sampling_freq;
+    block.elapsed = clock.seconds;
+    block.acquisition = clock.acquisitions;
+    block.daq_serial = settings.daq_serial;
+    block.channel = settings.channel;
+    if (!mixer.mix(block, settings.samples(), signals, &pool)) {
+        return;
+    }
+    auto snapshot = std::make_shared<acquisition_preview>();
+    snapshot->block = block;
+    snapshot->components = mixer.components;
+    snapshot->sum = mixer.sum;
+    std::lock_guard<std::mutex> lock(mutex);
+    latest = std::move(snapshot);
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include "signal.hpp"
+#include "signal_mixer.hpp"
+#include "thread_pool.hpp"
+#include "acquisition_scheduler.hpp"
+
+// Everything the engine needs besides the signals to generate and save an acquisition
+struct acquisition_settings {
+    int sampling_freq = 1000;
+    float duration = 10;   // seconds per acquisition
+    int interval = 10;     // seconds between periodic acquisitions
+    int sensor_type = 1;
+    int channel = 0;
+    int daq_serial = 1;
+    std::string data_folder;
+    bool periodic = true;
+
+    size_t samples() const { return size_t(sampling_freq * duration); }
+    bool operator==(const acquisition_settings&) const = default;
+};
+
+// What the UI draws: the samples of the current acquisition, per component and summed
+struct acquisition_preview {
+    sample_block block;
+    std::vector<signal_mixer::component> components;
+    std::vector<double> sum;
+
+    // Samples of the signal with this version, or nullptr while the engine has not generated it yet
+    const std::vector<double>* find(uint64_t version) const {
+        for (const auto& c : components) {
+            if (c.version == version) {
+                return &c.samples;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// Owns generation, the acquisition clock and the periodic save schedule on a thread of its own, so the
+// acquisition cadence does not depend on the frame rate, and a slow disk or an occluded window does not
+// stall either side. The UI publishes copies of its signals and settings and picks up preview snapshots.
+// Periodic saves fire at absolute deadlines from an acquisition_scheduler: enabling periodic saving or
+// changing the interval starts a new series at now + interval, after which every deadline is the previous
+// one plus the interval. A save that overruns whole intervals skips them instead of bunching up.
+class acquisition_engine {
+public:
+    using save_function = std::function<void(const acquisition_settings&, const std::vector<double>&)>;
+
+    explicit acquisition_engine(save_function save);
+    ~acquisition_engine();
+    acquisition_engine(const acquisition_engine&) = delete;
+    acquisition_engine& operator=(const acquisition_engine&) = delete;
+
+    // Hands the engine new parameters. Cheap to call every frame: nothing is copied or woken up unless the
+    // settings or a signal version changed since the last call.
+    void publish(const acquisition_settings& settings, const std::vector<std::unique_ptr<signal>>& signals);
+    void save_now();
+    void reset_clock();
+    // Latest snapshot; stays valid for as long as the caller holds it
+    std::shared_ptr<const acquisition_preview> preview() const;
+    // How late periodic saves started, and how many intervals were skipped because a save overran
+    lateness_histogram save_lateness() const;
+    uint64_t skipped_saves() const;
+
+private:
+    using clock_type = acquisition_scheduler::clock_type;
+
+    void run();
+    void generate_preview();
+    void schedule_saves(clock_type::time_point first);
+
+    save_function save;
+    thread_pool pool;
+    signal_mixer mixer;
+    acquisition_clock clock;
+    acquisition_scheduler scheduler;
+
+    // Shared with the UI thread, guarded by mutex
+    mutable std::mutex mutex;
+    acquisition_settings pending_settings;
+    std::vector<std::unique_ptr<signal>> pending_signals;
+    bool update_pending = false;
+    bool save_requested = false;
+    bool reset_requested = false;
+    std::shared_ptr<const acquisition_preview> latest;
+    lateness_histogram lateness;
+    uint64_t skipped = 0;
+
+    // UI side: what was published last, to skip unchanged frames
+    acquisition_settings published_settings;
+    std::vector<uint64_t> published_versions;
+    bool published = false;
+
+    // Engine side
+    acquisition_settings settings;
+    std::vector<std::unique_ptr<signal>> signals;
+    uint64_t series = 0;  // timer id of the current periodic series; timers of older series are ignored
+
+    std::thread worker;
+};
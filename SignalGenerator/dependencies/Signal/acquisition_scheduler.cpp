@@ -0,0 +1,129 @@
+#include "acquisition_scheduler.hpp"
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+acquisition_scheduler::acquisition_scheduler(std::chrono::nanoseconds tick)
+    : wheel(uint64_t(tick.count()), to_ns(clock_type::now())) {
+#ifdef __linux__
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer_fd < 0) {
+        failure = std::string("timerfd_create: ") + strerror(errno);
+        return;
+    }
+    event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (event_fd < 0) {
+        failure = std::string("eventfd: ") + strerror(errno);
+    }
+#endif
+}
+
+acquisition_scheduler::~acquisition_scheduler() {
+#ifdef __linux__
+    if (timer_fd >= 0) {
+        close(timer_fd);
+    }
+    if (event_fd >= 0) {
+        close(event_fd);
+    }
+#endif
+}
+
+bool acquisition_scheduler::valid() const {
+    return failure.empty();
+}
+
+const std::string& acquisition_scheduler::error() const {
+    return failure;
+}
+
+uint64_t acquisition_scheduler::to_ns(clock_type::time_point t) {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count());
+}
+
+void acquisition_scheduler::add(clock_type::time_point deadline, uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint64_t ns = to_ns(deadline);
+    wheel.add(ns, id);
+    if (ns < armed) {
+        interrupt();  // earlier than what the sleeping thread waits for
+    }
+}
+
+void acquisition_scheduler::wake() {
+    std::lock_guard<std::mutex> lock(mutex);
+    woken = true;
+    interrupt();
+}
+
+void acquisition_scheduler::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    interrupt();
+}
+
+// Called with the mutex held
+void acquisition_scheduler::interrupt() {
+#ifdef __linux__
+    const uint64_t one = 1;
+    (void)!write(event_fd, &one, sizeof(one));
+#else
+    wake_cv.notify_one();
+#endif
+}
+
+lateness_histogram acquisition_scheduler::lateness() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return histogram;
+}
+
+bool acquisition_scheduler::wait(std::vector<timer>& fired) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (stopping || !valid()) {
+            return false;
+        }
+        const uint64_t now = to_ns(clock_type::now());
+        due.clear();
+        wheel.expire(now, due);
+        for (const timer_wheel::timer& t : due) {
+            histogram.record(double(now - t.deadline) * 1e-3);
+            fired.push_back(timer{ clock_type::time_point(std::chrono::duration_cast<clock_type::duration>(std::chrono::nanoseconds(t.deadline))), t.id });
+        }
+        if (!due.empty() || woken) {
+            woken = false;
+            armed = UINT64_MAX;
+            return true;
+        }
+        armed = wheel.next_wakeup();
+#ifdef __linux__
+        // Armed and slept on outside the lock; an add() that comes in between sees armed and interrupts
+        const uint64_t wakeup = armed;
+        lock.unlock();
+        itimerspec spec = {};
+        if (wakeup != UINT64_MAX) {
+            spec.it_value.tv_sec = time_t(wakeup / 1000000000);
+            spec.it_value.tv_nsec = long(wakeup % 1000000000);
+        }
+        timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+        pollfd fds[2] = { { timer_fd, POLLIN, 0 }, { event_fd, POLLIN, 0 } };
+        poll(fds, 2, -1);
+        uint64_t drained;
+        (void)!read(timer_fd, &drained, sizeof(drained));
+        (void)!read(event_fd, &drained, sizeof(drained));
+        lock.lock();
+#else
+        if (armed == UINT64_MAX) {
+            wake_cv.wait(lock);
+        }
+        else {
+            wake_cv.wait_until(lock, clock_type::time_point(std::chrono::duration_cast<clock_type::duration>(std::chrono::nanoseconds(armed))));
+        }
+#endif
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "timer_wheel.hpp"
+#include "lateness_histogram.hpp"
+#ifndef __linux__
+#include <condition_variable>
+#endif
+
+// Fires timers at absolute steady_clock deadlines, for one scheduling thread and any number of threads
+// adding timers. Periodic work re-adds deadline + interval rather than now + interval, so it never drifts,
+// however late a wakeup was. Timers wait in a timer_wheel; the scheduling thread sleeps until the wheel's
+// next wakeup on a timerfd armed with an absolute CLOCK_MONOTONIC time (the clock behind steady_clock on
+// Linux), next to an eventfd that add(), wake() and stop() use to interrupt it. Elsewhere it waits on a
+// condition variable until the same absolute time.
+class acquisition_scheduler {
+public:
+    using clock_type = std::chrono::steady_clock;
+    struct timer {
+        clock_type::time_point deadline;
+        uint64_t id;
+    };
+
+    explicit acquisition_scheduler(std::chrono::nanoseconds tick = std::chrono::milliseconds(1));
+    ~acquisition_scheduler();
+    acquisition_scheduler(const acquisition_scheduler&) = delete;
+    acquisition_scheduler& operator=(const acquisition_scheduler&) = delete;
+
+    // Thread safe. Deadlines in the past fire on the next wait().
+    void add(clock_type::time_point deadline, uint64_t id);
+    // False when the timerfd or the eventfd could not be created (out of file descriptors, say), with error()
+    // saying why; wait() then returns false at once rather than sleep on nothing forever
+    bool valid() const;
+    const std::string& error() const;
+    // Sleeps until a deadline passes or wake() is called, then appends the due timers, earliest first, and
+    // records how late each fired. Returns false once stop() was called, or when the scheduler is not valid().
+    bool wait(std::vector<timer>& fired);
+    // Makes wait() return, with or without timers
+    void wake();
+    void stop();
+    // Time from each timer's deadline to wait() returning it
+    lateness_histogram lateness() const;
+
+private:
+    static uint64_t to_ns(clock_type::time_point t);
+    void interrupt();
+
+    mutable std::mutex mutex;
+    timer_wheel wheel;
+    lateness_histogram histogram;
+    std::vector<timer_wheel::timer> due;
+    uint64_t armed = UINT64_MAX;  // wakeup the sleeping thread was armed for
+    bool woken = false;
+    bool stopping = false;
+    std::string failure;
+#ifdef __linux__
+    int timer_fd = -1;
+    int event_fd = -1;
+#else
+    std::condition_variable wake_cv;
+#endif
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+
+// How late events happened, in power-of-two buckets of microseconds: bucket 0 counts lateness under 1 us,
+// bucket b in [2^(b-1), 2^b) us, and the last bucket everything from 2^28 us (about 4.5 minutes) on.
+struct lateness_histogram {
+    static constexpr size_t buckets = 30;
+    uint64_t counts[buckets] = {};
+    uint64_t count = 0;
+    double sum_us = 0;
+    double max_us = 0;
+
+    void record(double lateness_us) {
+        lateness_us = std::max(lateness_us, 0.0);
+        size_t b = 0;
+        while (b + 1 < buckets && lateness_us >= double(uint64_t(1) << b)) {
+            b++;
+        }
+        counts[b]++;
+        count++;
+        sum_us += lateness_us;
+        max_us = std::max(max_us, lateness_us);
+    }
+    void merge(const lateness_histogram& other) {
+        for (size_t b = 0; b < buckets; b++) {
+            counts[b] += other.counts[b];
+        }
+        count += other.count;
+        sum_us += other.sum_us;
+        max_us = std::max(max_us, other.max_us);
+    }
+    double mean_us() const { return count ? sum_us / double(count) : 0; }
+    // Upper edge of the bucket holding quantile q (0..1), so an upper bound within a factor of two
+    double quantile_us(double q) const {
+        const double wanted = q * double(count);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < buckets; b++) {
+            seen += counts[b];
+            if (count && double(seen) >= wanted) {
+                return std::min(max_us, double(uint64_t(1) << b));
+            }
+        }
+        return max_us;
+    }
+    // One line per non-empty bucket with a bar scaled to the fullest one
+    void print(FILE* out, const char* title) const {
+        fprintf(out, "%s: %llu events, mean %.1f us, p50 <= %.0f us, p99 <= %.0f us, max %.1f us\n", title,
+            (unsigned long long)count, mean_us(), quantile_us(0.5), quantile_us(0.99), max_us);
+        const uint64_t fullest = *std::max_element(counts, counts + buckets);
+        for (size_t b = 0; b < buckets; b++) {
+            if (counts[b] == 0) {
+                continue;
+            }
+            const double low = b == 0 ? 0 : double(uint64_t(1) << (b - 1));
+            fprintf(out, "  %9.0f us+ %10llu  ", low, (unsigned long long)counts[b]);
+            for (uint64_t i = 0; i < (counts[b] * 40 + fullest - 1) / fullest; i++) {
+                fputc('#', out);
+            }
+            fputc('\n', out);
+        }
+    }
+};
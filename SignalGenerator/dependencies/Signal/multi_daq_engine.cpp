@@ -0,0 +1,299 @@
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include "multi_daq_engine.hpp"
+#include "signal_mixer.hpp"
+#include "binary_file.hpp"
+
+// One released acquisition of one DAQ, shared by its channel tasks; the last one to finish records it
+struct multi_daq_engine::acquisition {
+    size_t daq;
+    size_t index;
+    time_t acquired;             // names its files: start of the run + index * interval (at least a second), so
+                                 // acquisitions released back to back still get names of their own
+    clock_type::time_point deadline;
+    bool paced;
+    bool write;
+    bool combined;               // one version 4 file for all channels
+    std::vector<double> samples; // combined: every channel planar, each channel task filling its own slice
+    std::atomic<int> remaining{ 0 };
+};
+
+multi_daq_engine::multi_daq_engine(std::vector<virtual_daq> daqs, size_t threads)
+    : daq_list(std::move(daqs)), busy(new std::atomic<bool>[daq_list.size()]), pool(threads) {
+    for (size_t d = 0; d < daq_list.size(); d++) {
+        busy[d] = false;
+        const std::filesystem::path folder = std::filesystem::path(daq_list[d].data_folder) / std::to_string(daq_list[d].config.daq_serial_number);
+        std::error_code ec;
+        std::filesystem::create_directories(folder, ec);
+        folders.push_back(folder.string());
+    }
+}
+
+bool multi_daq_engine::run(const run_options& options) {
+    if (!scheduler.valid()) {
+        return false;
+    }
+    file = options.file;
+    started = time(0);
+    std::unique_ptr<async_writer> created;
+    if (options.write && file.backend != file_backend_kind::mmap) {
+        async_writer::options writer_options;
+        writer_options.writers = options.writers;
+        writer_options.queue_depth = options.queue_depth != 0 ? options.queue_depth : 2 * pool.size();
+        writer_options.drop_when_full = options.drop_when_full;
+        writer_options.compress_threads = options.compress_threads;
+        writer_options.file = options.file;
+        created = std::make_unique<async_writer>(writer_options);
+    }
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        writer = std::move(created);
+    }
+    // Timer ids are DAQ indices. A paced DAQ re-arms at deadline + interval when it fires; a DAQ that
+    // acquires back to back (no-wait, or no interval) is re-armed by its last channel task.
+    std::vector<size_t> taken(daq_list.size(), 0);
+    size_t active = 0;
+    const clock_type::time_point start = clock_type::now();
+    for (size_t d = 0; d < daq_list.size(); d++) {
+        if (options.acquisitions == 0 || taken[d] < options.acquisitions) {
+            scheduler.add(start, d);
+            active++;
+        }
+    }
+    std::vector<acquisition_scheduler::timer> fired;
+    while (active > 0 && scheduler.wait(fired)) {
+        for (const auto& t : fired) {
+            const size_t d = size_t(t.id);
+            if (options.acquisitions != 0 && taken[d] >= options.acquisitions) {
+                continue;
+            }
+            const size_t index = taken[d]++;
+            const bool paced = options.wait && daq_list[d].config.acq_interval > 0;
+            if (busy[d]) {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                totals.overruns++;
+            }
+            else {
+                {
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    totals.release_lateness.record(std::chrono::duration<double, std::micro>(clock_type::now() - t.deadline).count());
+                }
+                release(d, index, t.deadline, paced, options.write);
+            }
+            if (options.acquisitions != 0 && taken[d] >= options.acquisitions) {
+                active--;
+            }
+            else if (paced) {
+                scheduler.add(t.deadline + std::chrono::seconds(daq_list[d].config.acq_interval), d);
+            }
+        }
+        fired.clear();
+    }
+    pool.wait_idle();
+    if (writer) {
+        writer->flush();
+    }
+    return true;
+}
+
+void multi_daq_engine::stop() {
+    scheduler.stop();
+}
+
+void multi_daq_engine::release(size_t daq, size_t index, clock_type::time_point deadline, bool paced, bool write) {
+    auto acq = std::make_shared<acquisition>();
+    acq->daq = daq;
+    acq->index = index;
+    acq->acquired = started + time_t(index) * std::max(daq_list[daq].config.acq_interval, 1);
+    acq->deadline = deadline;
+    acq->paced = paced;
+    acq->write = write;
+    acq->combined = write && file.version >= 4;
+    std::vector<int> channels;
+    for (int c = 0; c < 4; c++) {
+        if (daq_list[daq].config.channels[c].status == 1) {
+            channels.push_back(c);
+        }
+    }
+    if (channels.empty()) {
+        if (!paced) {
+            scheduler.add(clock_type::now(), daq);
+        }
+        return;
+    }
+    busy[daq] = true;
+    acq->remaining = int(channels.size());
+    if (acq->combined) {
+        const size_t values = daq_list[daq].samples() * channels.size();
+        acq->samples = writer ? writer->acquire(values) : std::vector<double>(values);
+    }
+    for (size_t slot = 0; slot < channels.size(); slot++) {
+        const int c = channels[slot];
+        pool.submit([this, acq, c, slot] { channel_task(acq, c, slot); });
+    }
+}
+
+void multi_daq_engine::channel_task(const std::shared_ptr<acquisition>& acq, int channel, size_t slot) {
+    virtual_daq& daq = daq_list[acq->daq];
+    sample_block block;
+    block.sampling_freq = daq.config.sampling_freq;
+    block.elapsed = double(acq->index) * daq.config.acq_interval;
+    block.acquisition = acq->index;
+    block.daq_serial = daq.config.daq_serial_number;
+    block.channel = channel;
+    if (acq->combined) {
+        const size_t samples = daq.samples();
+        const clock_type::time_point t = clock_type::now();
+        mix_signals(block, daq.signals, std::span<double>(acq->samples.data() + slot * samples, samples));
+        generate_ns += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t).count());
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            totals.samples += samples;
+        }
+        if (--acq->remaining == 0) {
+            write_combined(acq);
+        }
+        return;
+    }
+    if (acq->write && file.backend == file_backend_kind::mmap && write_mapped(acq, block, channel)) {
+        channel_done(acq);
+        return;
+    }
+
+    // Generated straight into a pooled buffer that moves to the writer; without writing, one buffer per worker
+    thread_local std::vector<double> scratch;
+    std::vector<double> y = acq->write && writer ? writer->acquire(daq.samples()) : std::move(scratch);
+    y.resize(daq.samples());
+    const clock_type::time_point t = clock_type::now();
+    mix_signals(block, daq.signals, y);
+    generate_ns += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t).count());
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        totals.samples += y.size();
+    }
+
+    if (!acq->write || !writer) {
+        if (acq->write) {
+            // Mapping failed; write the generated samples synchronously
+            ACQCONFIG config = daq.config;
+            const clock_type::time_point w = clock_type::now();
+            BinaryFile output(folders[acq->daq], config, channel, file, acq->acquired);
+            const bool written = output.writeAll(y) == 0;
+            write_ns += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - w).count());
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            totals.files += written;
+            totals.bytes += written ? output.bytesWritten() : 0;
+        }
+        scratch = std::move(y);
+        channel_done(acq);
+        return;
+    }
+    write_job job;
+    job.folder = folders[acq->daq];
+    job.config = daq.config;
+    job.channel = channel;
+    job.acquired = acq->acquired;
+    job.samples = std::move(y);
+    job.done = [this, acq](bool) { channel_done(acq); };
+    writer->submit(std::move(job));
+}
+
+// Generates the channel tile by tile and copies each tile into the mapped file while it is still in L1, so the
+// acquisition never exists as a separate buffer. False when the file could not be mapped.
+bool multi_daq_engine::write_mapped(const std::shared_ptr<acquisition>& acq, const sample_block& block, int channel) {
+    virtual_daq& daq = daq_list[acq->daq];
+    const size_t samples = daq.samples();
+    clock_type::time_point t = clock_type::now();
+    ACQCONFIG config = daq.config;
+    BinaryFile output(folders[acq->daq], config, channel, file, acq->acquired);
+    char* mapped = static_cast<char*>(output.mapData(samples));
+    if (mapped == nullptr) {
+        return false;
+    }
+    uint64_t write_time = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t).count());
+
+    t = clock_type::now();
+    double tile[signal_mixer::tile_size];
+    for (size_t first = 0; first < samples; first += signal_mixer::tile_size) {
+        const size_t n = std::min(signal_mixer::tile_size, samples - first);
+        sample_block part = block;
+        part.first = block.first + first;
+        mix_signals(part, daq.signals, std::span<double>(tile, n));
+        memcpy(mapped + first * sizeof(double), tile, n * sizeof(double));
+    }
+    generate_ns += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t).count());
+
+    t = clock_type::now();
+    const bool written = output.close() == 0;
+    write_time += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t).count());
+    write_ns += write_time;
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    totals.samples += samples;
+    totals.files += written;
+    totals.bytes += written ? output.bytesWritten() : 0;
+    return true;
+}
+
+// Called by the last channel task to finish generating: all channels go to one file, on the writer when there is
+// one (not with mmap)
+void multi_daq_engine::write_combined(const std::shared_ptr<acquisition>& acq) {
+    virtual_daq& daq = daq_list[acq->daq];
+    if (writer) {
+        write_job job;
+        job.folder = folders[acq->daq];
+        job.config = daq.config;
+        job.channel = -1;
+        job.acquired = acq->acquired;
+        job.samples = std::move(acq->samples);
+        job.done = [this, acq](bool) { finish_acquisition(acq); };
+        writer->submit(std::move(job));
+        return;
+    }
+    ACQCONFIG config = daq.config;
+    const clock_type::time_point t = clock_type::now();
+    BinaryFile output(folders[acq->daq], config, file, acq->acquired);
+    const bool written = output.writeAll(acq->samples) == 0;
+    write_ns += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t).count());
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        totals.files += written;
+        totals.bytes += written ? output.bytesWritten() : 0;
+    }
+    finish_acquisition(acq);
+}
+
+// The last channel of an acquisition to be written (or dropped) completes it
+void multi_daq_engine::channel_done(const std::shared_ptr<acquisition>& acq) {
+    if (--acq->remaining == 0) {
+        finish_acquisition(acq);
+    }
+}
+
+void multi_daq_engine::finish_acquisition(const std::shared_ptr<acquisition>& acq) {
+    const clock_type::time_point now = clock_type::now();
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        totals.acquisitions++;
+        totals.completion.record(std::chrono::duration<double, std::micro>(now - acq->deadline).count());
+    }
+    busy[acq->daq] = false;
+    if (!acq->paced) {
+        scheduler.add(now, acq->daq);
+    }
+}
+
+multi_daq_engine::statistics multi_daq_engine::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    statistics s = totals;
+    s.generate_seconds = double(generate_ns) * 1e-9;
+    s.write_seconds = double(write_ns) * 1e-9;
+    if (writer) {
+        s.writer = writer->stats();
+        s.files += s.writer.written;
+        s.bytes += s.writer.bytes;
+        s.write_seconds += s.writer.write_seconds;
+    }
+    s.steals = pool.steals();
+    return s;
+}
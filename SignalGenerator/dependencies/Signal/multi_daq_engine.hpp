@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <ctime>
+#include "ACQConfig.hpp"
+#include "async_writer.hpp"
+#include "signal.hpp"
+#include "work_stealing_pool.hpp"
+#include "acquisition_scheduler.hpp"
+#include "lateness_histogram.hpp"
+
+// One simulated DAQ: its own schedule and its own signal, acquired on every channel whose status is 1.
+// Sensitivity and sensor type come from the channel's entry in config.
+struct virtual_daq {
+    ACQCONFIG config;      // serial, sampling frequency, interval and the four channels
+    double duration = 10;  // seconds per acquisition (config.acq_duration only holds whole seconds)
+    std::string data_folder;
+    std::vector<std::unique_ptr<signal>> signals;
+
+    size_t samples() const { return size_t(config.sampling_freq * duration); }
+};
+
+// Runs any number of virtual DAQs at once. A scheduler thread (the caller of run()) releases each DAQ's
+// acquisitions at absolute deadlines, start + k * interval, from an acquisition_scheduler; every enabled channel
+// of an acquisition becomes one task on a shared work_stealing_pool, which generates the sum tile by tile into a
+// buffer from an async_writer and moves it to the writer threads, so pool workers never wait on the disk unless
+// the write queue is full. With the mmap backend there is no buffer and no writer: each tile is copied straight
+// into the mapped file as soon as it is generated. With file format 4 the channel tasks of an acquisition fill
+// slices of one planar buffer and the last one to finish hands it on as a single file. A DAQ whose previous
+// acquisition is still being written when the next one is due skips it and counts an overrun, like a real DAQ
+// with a full buffer, so an overloaded box shows up as overruns instead of an ever-growing queue.
+class multi_daq_engine {
+public:
+    struct run_options {
+        size_t acquisitions = 0;  // per DAQ; 0 runs until stop()
+        bool wait = true;         // false releases each DAQ's acquisitions back to back, to measure throughput
+        bool write = true;        // false only generates, to measure generation alone
+        size_t writers = 2;       // writer threads
+        size_t queue_depth = 0;   // acquisitions of one channel waiting to be written; 0 is two per pool thread
+        bool drop_when_full = false;  // drop channels when the write queue is full instead of stalling the pool
+        size_t compress_threads = 1;  // with file.compress: threads compressing each file's chunks, per writer
+        file_options file;
+    };
+    struct statistics {
+        uint64_t acquisitions = 0;  // completed, all channels written
+        uint64_t overruns = 0;      // skipped because the previous one was still running
+        uint64_t files = 0;
+        uint64_t samples = 0;
+        uint64_t bytes = 0;           // of the files written, as stored
+        double generate_seconds = 0;  // summed over all tasks (CPU time, not wall time)
+        double write_seconds = 0;     // summed over writer threads, or over tasks opening and closing mapped files
+        async_writer::statistics writer;  // queue depth, stalls and drops of the last run (not used with mmap)
+        lateness_histogram release_lateness;  // deadline to the scheduler releasing the acquisition
+        lateness_histogram completion;        // deadline to the last channel written
+        uint64_t steals = 0;
+    };
+
+    // Files of each DAQ go to its data_folder/<serial>/, created here
+    multi_daq_engine(std::vector<virtual_daq> daqs, size_t threads = std::thread::hardware_concurrency());
+    multi_daq_engine(const multi_daq_engine&) = delete;
+    multi_daq_engine& operator=(const multi_daq_engine&) = delete;
+
+    // Blocks until every DAQ has taken options.acquisitions acquisitions, or stop() is called, and their
+    // files are written. False, having run nothing, when the scheduler could not be set up; error() says why.
+    bool run(const run_options& options);
+    std::string error() const { return scheduler.error(); }
+    // Callable from any thread
+    void stop();
+    statistics stats() const;
+    const std::vector<virtual_daq>& daqs() const { return daq_list; }
+
+private:
+    using clock_type = acquisition_scheduler::clock_type;
+    struct acquisition;
+
+    void release(size_t daq, size_t index, clock_type::time_point deadline, bool paced, bool write);
+    void channel_task(const std::shared_ptr<acquisition>& acq, int channel, size_t slot);
+    void channel_done(const std::shared_ptr<acquisition>& acq);
+    void finish_acquisition(const std::shared_ptr<acquisition>& acq);
+    void write_combined(const std::shared_ptr<acquisition>& acq);
+    bool write_mapped(const std::shared_ptr<acquisition>& acq, const sample_block& block, int channel);
+
+    std::vector<virtual_daq> daq_list;
+    std::vector<std::string> folders;
+    std::unique_ptr<std::atomic<bool>[]> busy;  // per DAQ: an acquisition is in flight
+    work_stealing_pool pool;
+    acquisition_scheduler scheduler;
+
+    mutable std::mutex stats_mutex;
+    statistics totals;
+    std::atomic<uint64_t> generate_ns{ 0 };
+    std::atomic<uint64_t> write_ns{ 0 };  // mapped files only
+    file_options file;  // of the current run
+    time_t started = 0;  // wall clock at the start of the current run
+    std::unique_ptr<async_writer> writer;  // created by run() when it writes; guarded by stats_mutex
+};
@@ -0,0 +1,254 @@
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstdlib>
+#include "scenario.hpp"
+
+namespace {
+
+std::string trim(const std::string& s) {
+    const size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+bool parse_number(const std::string& text, double& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return *end == '\0';
+}
+
+// "1 2 5" or "1-100" or a mix of both
+bool parse_int_list(const std::string& text, std::vector<int>& values) {
+    values.clear();
+    std::istringstream words(text);
+    std::string word;
+    while (words >> word) {
+        const size_t dash = word.find('-', 1);
+        double first, last;
+        if (dash == std::string::npos) {
+            if (!parse_number(word, first)) {
+                return false;
+            }
+            last = first;
+        }
+        else if (!parse_number(word.substr(0, dash), first) || !parse_number(word.substr(dash + 1), last) || last < first) {
+            return false;
+        }
+        for (int v = int(first); v <= int(last); v++) {
+            values.push_back(v);
+        }
+    }
+    return !values.empty();
+}
+
+// Component line: kind followed by name=value pairs
+bool parse_component(const std::string& kind, std::istringstream& rest, daq_group& out, std::string& error) {
+    std::map<std::string, double> params;
+    std::string pair;
+    while (rest >> pair) {
+        const size_t eq = pair.find('=');
+        double value;
+        if (eq == std::string::npos || !parse_number(pair.substr(eq + 1), value)) {
+            error = "expected name=value, got '" + pair + "'";
+            return false;
+        }
+        params[pair.substr(0, eq)] = value;
+    }
+    auto take = [&params](const char* name, double fallback) {
+        auto it = params.find(name);
+        if (it == params.end()) {
+            return fallback;
+        }
+        const double value = it->second;
+        params.erase(it);
+        return value;
+    };
+
+    if (kind == "sin") {
+        auto s = std::make_unique<sin_signal>(float(take("frequency", 1)), float(take("phase", 0)), float(take("amplitude", 1)));
+        s->increase_over_time_ratio = float(take("increase", 0));
+        out.signals.push_back(std::move(s));
+    }
+    else if (kind == "pulse") {
+        out.signals.push_back(std::make_unique<pulse_train>(float(take("frequency", 1)), float(take("duty", 0.05)), float(take("amplitude", 1))));
+    }
+    else if (kind == "noise") {
+        const float amplitude = float(take("amplitude", 0.5));
+        out.signals.push_back(std::make_unique<white_signal>(amplitude, unsigned(take("seed", 0))));
+    }
+    else {
+        error = "unknown setting or component '" + kind + "'";
+        return false;
+    }
+    if (!params.empty()) {
+        error = "unknown " + kind + " parameter '" + params.begin()->first + "'";
+        return false;
+    }
+    return true;
+}
+
+daq_group copy_group(const daq_group& group) {
+    daq_group copy;
+    copy.serials = group.serials;
+    copy.channels = group.channels;
+    copy.sampling_freq = group.sampling_freq;
+    copy.duration = group.duration;
+    copy.interval = group.interval;
+    copy.sensor_type = group.sensor_type;
+    copy.sensitivity = group.sensitivity;
+    for (const auto& s : group.signals) {
+        copy.signals.push_back(s->clone());
+    }
+    return copy;
+}
+
+} // namespace
+
+size_t scenario::daq_count() const {
+    size_t count = 0;
+    for (const auto& group : groups) {
+        count += group.serials.size();
+    }
+    return count;
+}
+
+std::vector<virtual_daq> scenario::make_daqs() const {
+    std::vector<virtual_daq> daqs;
+    for (const auto& group : groups) {
+        for (int serial : group.serials) {
+            virtual_daq daq;
+            daq.config.daq_serial_number = serial;
+            daq.config.acq_interval = group.interval;
+            daq.config.acq_duration = int(group.duration);
+            daq.config.sampling_freq = group.sampling_freq;
+            daq.config.parse_status = 0;
+            daq.config.start_channel = group.channels.front();
+            daq.config.channel_count = int(group.channels.size());
+            for (int channel : group.channels) {
+                daq.config.channels[channel].status = 1;
+                daq.config.channels[channel].sensitivity = group.sensitivity;
+                daq.config.channels[channel].sensor_type = group.sensor_type;
+            }
+            daq.duration = group.duration;
+            daq.data_folder = data_folder;
+            for (const auto& s : group.signals) {
+                daq.signals.push_back(s->clone());
+            }
+            daqs.push_back(std::move(daq));
+        }
+    }
+    return daqs;
+}
+
+bool load_scenario(const std::string& path, scenario& out, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open scenario file " + path;
+        return false;
+    }
+    daq_group defaults;
+    daq_group* group = &defaults;     // what settings and components apply to
+    bool inherited_signals = false;   // the current section still has the defaults' components
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        std::string problem;
+        if (line.front() == '[') {
+            std::istringstream words(line.substr(1, line.find(']') - 1));
+            std::string word, serials;
+            words >> word;
+            std::getline(words, serials);
+            std::vector<int> section_serials;
+            if (line.back() != ']' || word != "daq" || !parse_int_list(serials, section_serials)) {
+                error = path + ":" + std::to_string(number) + ": expected [daq <serials>]";
+                return false;
+            }
+            out.groups.push_back(copy_group(defaults));
+            group = &out.groups.back();
+            group->serials = section_serials;
+            inherited_signals = true;
+            continue;
+        }
+        // "key = value" when the first word is followed by '=', otherwise a component
+        const size_t key_end = line.find_first_of(" \t=");
+        const size_t eq = key_end == std::string::npos ? key_end : line.find_first_not_of(" \t", key_end);
+        if (eq != std::string::npos && line[eq] == '=') {
+            const std::string key = line.substr(0, key_end);
+            const std::string value = trim(line.substr(eq + 1));
+            double number_value = 0;
+            const bool numeric = parse_number(value, number_value);
+            if (key == "data_folder") {
+                out.data_folder = value;
+            }
+            else if (key == "serials") {
+                if (!parse_int_list(value, group->serials)) {
+                    problem = "bad serial list '" + value + "'";
+                }
+            }
+            else if (key == "channels") {
+                if (!parse_int_list(value, group->channels)) {
+                    problem = "bad channel list '" + value + "'";
+                }
+                for (int channel : group->channels) {
+                    if (channel < 0 || channel > 3) {
+                        problem = "channels must be 0..3";
+                    }
+                }
+            }
+            else if (!numeric) {
+                problem = "'" + key + "' needs a number, got '" + value + "'";
+            }
+            else if (key == "sampling_freq" && number_value >= 1) {
+                group->sampling_freq = int(number_value);
+            }
+            else if (key == "duration" && number_value > 0) {
+                group->duration = float(number_value);
+            }
+            else if (key == "interval" && number_value >= 0) {
+                group->interval = int(number_value);
+            }
+            else if (key == "acquisitions" && number_value >= 0) {
+                out.acquisitions = size_t(number_value);
+            }
+            else if (key == "sensor_type") {
+                group->sensor_type = int(number_value);
+            }
+            else if (key == "sensitivity") {
+                group->sensitivity = int(number_value);
+            }
+            else if (key == "sampling_freq" || key == "duration" || key == "interval" || key == "acquisitions") {
+                problem = "'" + key + "' is out of range";
+            }
+            else {
+                problem = "unknown setting '" + key + "'";
+            }
+        }
+        else {
+            std::istringstream words(line);
+            std::string kind;
+            words >> kind;
+            if (inherited_signals) {
+                group->signals.clear();
+                inherited_signals = false;
+            }
+            parse_component(kind, words, *group, problem);
+        }
+        if (!problem.empty()) {
+            error = path + ":" + std::to_string(number) + ": " + problem;
+            return false;
+        }
+    }
+    if (out.groups.empty()) {
+        out.groups.push_back(std::move(defaults));
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include "signal.hpp"
+#include "multi_daq_engine.hpp"
+
+// DAQs that share settings and components. Every channel gets the same components; noise still differs per
+// DAQ and channel (see noise_stream).
+struct daq_group {
+    std::vector<int> serials{ 1 };
+    std::vector<int> channels{ 0 };
+    int sampling_freq = 1000;
+    float duration = 10;
+    int interval = 10;
+    int sensor_type = 1;
+    int sensitivity = 1;
+    std::vector<std::unique_ptr<signal>> signals;
+
+    size_t samples() const { return size_t(sampling_freq * duration); }
+};
+
+// A headless simulation: which DAQs and channels to acquire, how often, and what they carry.
+//
+// Scenario files are line based. '#' starts a comment, settings are "key = value", components are a kind
+// followed by name=value parameters:
+//
+//     acquisitions = 0             # per DAQ; stop after this many, 0 runs until killed
+//     data_folder = ./Data         # files go to data_folder/<serial>/
+//     sampling_freq = 20000        # Hz
+//     duration = 10                # seconds per acquisition
+//     interval = 10                # seconds between acquisitions
+//     sensor_type = 1
+//     sensitivity = 1
+//     serials = 1 2 3              # DAQ serial numbers, or a range: 1-100
+//     channels = 0 1 2 3           # channels per DAQ, 0..3
+//     sin frequency=50 amplitude=1 phase=0 increase=0
+//     pulse frequency=25 duty=0.05 amplitude=1
+//     noise amplitude=0.2 seed=7
+//
+// That describes a single group. For DAQs with different schedules or signals, start a section per group with
+// "[daq <serials>]": a section starts from the settings and components above the first section, and a section
+// that lists components of its own replaces the inherited ones.
+//
+//     [daq 1-40]
+//     interval = 5
+//     [daq 41-50]
+//     sampling_freq = 50000
+//     sin frequency=120 amplitude=0.5
+struct scenario {
+    size_t acquisitions = 0;
+    std::string data_folder = ".";
+    std::vector<daq_group> groups;
+
+    size_t daq_count() const;
+    // One virtual_daq per serial, with its own copies of the group's signals
+    std::vector<virtual_daq> make_daqs() const;
+};
+
+// Returns false and describes the first problem in error (with its line number) if the file cannot be used
+bool load_scenario(const std::string& path, scenario& out, std::string& error);
@@ -0,0 +1,188 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include "signal_kernels.hpp"
+
+#ifndef M_PI
+# define M_PI           3.14159265358979323846  /* pi */
+#endif
+
+// Simulated acquisition time, owned by the engine. It only moves when an acquisition is taken, so the
+// generated signals do not depend on wall-clock time or on how often the UI redraws.
+class acquisition_clock {
+public:
+    double seconds = 0;       // simulated time since the last reset
+    size_t acquisitions = 0;  // acquisitions taken since the last reset
+
+    void advance(double interval) {
+        seconds += interval;
+        acquisitions++;
+    }
+    void reset() {
+        seconds = 0;
+        acquisitions = 0;
+    }
+};
+
+// A contiguous run of uniformly spaced samples: out[i] is the signal at time (first + i) / sampling_freq
+struct sample_block {
+    size_t first = 0;
+    double sampling_freq = 1;
+    double elapsed = 0;  // acquisition clock time (s) of the acquisition this block belongs to
+    size_t acquisition = 0;  // acquisition clock index, selects the noise of that acquisition
+    int daq_serial = 0;
+    int channel = 0;
+
+    double time(size_t i) const { return double(first + i) / sampling_freq; }
+    bool operator==(const sample_block&) const = default;
+};
+
+class signal {
+public:
+    virtual ~signal() = default;  // Virtual destructor for polymorphism
+    // Independent copy with the same parameters and version, for handing to another thread
+    virtual std::unique_ptr<signal> clone() const = 0;
+    // Per-sample reference path, slow (one virtual call per sample); kept for checking generate()
+    virtual double out(double x) { return 0; }
+    // Fill a whole block of samples in one call
+    virtual void generate(const sample_block& block, std::span<double> out) {
+        for (size_t i = 0; i < out.size(); i++) {
+            out[i] = this->out(block.time(i));
+        }
+    }
+    // Changes whenever a parameter is edited (call touch()). Versions are unique across all signals, so a
+    // cache keyed on the version alone never mistakes a new signal for a deleted one.
+    uint64_t version() const { return version_; }
+    void touch() { version_ = next_version(); }
+
+private:
+    uint64_t version_ = next_version();
+    static uint64_t next_version() {
+        static std::atomic<uint64_t> counter{ 0 };
+        return ++counter;
+    }
+};
+
+class sin_signal : public signal {
+public:
+    sin_signal(float frequency, float phase, float amplitude)
+        : signal() {  // Initialize base class first
+        this->frequency = frequency;
+        this->phase = phase;
+        this->amplitude = amplitude;
+    }
+    std::unique_ptr<signal> clone() const override { return std::make_unique<sin_signal>(*this); }
+    double frequency;
+    float phase;
+    double amplitude;
+    float increase_over_time_ratio = 0;  // amplitude change per minute of acquisition clock time
+    double amplitude_at(double elapsed) const {
+        return amplitude + double(increase_over_time_ratio * float(elapsed)) / double(60.0);
+    }
+    // Reference path, evaluated at acquisition clock zero
+    double out(double x) override {
+        double y;
+        y = amplitude_at(0) * sin(2 * M_PI * frequency * x + phase);
+        return y;
+    }
+    // Filled in segments pinned to absolute multiples of resync_interval, so a block gives the same samples
+    // however it is split. Each segment starts from the reference phase 2*pi*f*t + phase (reduced mod 2*pi)
+    // and is handed to the dispatched sine kernel (see signal_kernels.hpp for its accuracy). Against out()
+    // the error is |y - y_ref| <= amplitude * (2 * ulp(theta) + 1e-13), where ulp(theta) is the rounding of
+    // the reference's own phase argument. Measured over 10 s at 200 kHz: 1e-12 at 50 Hz, 2e-11 at 1 kHz,
+    // 4e-10 at 20 kHz (all amplitude-relative).
+    static constexpr size_t resync_interval = 256;
+    void generate(const sample_block& block, std::span<double> out) override {
+        const double w = 2 * M_PI * frequency;
+        const double step = w / block.sampling_freq;
+        const double a = amplitude_at(block.elapsed);
+        const signal_kernels& kernels = active_kernels();
+        size_t i = 0;
+        while (i < out.size()) {
+            const size_t n = block.first + i;
+            const size_t seed = n - n % resync_interval;
+            const size_t end = std::min(out.size(), i + (seed + resync_interval - n));
+            double theta0 = fmod(w * (double(seed) / block.sampling_freq) + phase, 2 * M_PI);
+            if (theta0 < 0) {
+                theta0 += 2 * M_PI;
+            }
+            kernels.sine(&out[i], end - i, theta0, step, n - seed, a);
+            i = end;
+        }
+    }
+};
+
+class pulse_train : public signal {
+public:
+    pulse_train(float frequency, float duty_cycle, float amplitude)
+        : signal() {
+        this->frequency = frequency;
+        this->duty_cycle = duty_cycle;
+        this->amplitude = amplitude;
+    }
+
+    std::unique_ptr<signal> clone() const override { return std::make_unique<pulse_train>(*this); }
+    double frequency;
+    float duty_cycle;  // Percentage of the period where the pulse is high (0 to 1)
+    double amplitude;
+
+    double out(double x) override {
+        double period = 1.0 / frequency;
+        double time_in_period = fmod(x, period);
+        return (time_in_period < duty_cycle* period) ? amplitude : 0.0;
+    }
+    // Compares the fractional cycle count against the duty cycle; segments are pinned like sin_signal's.
+    // Differs from out() only on samples that fall exactly on an edge, where fmod(x, period) rounds either way.
+    static constexpr size_t resync_interval = 256;
+    void generate(const sample_block& block, std::span<double> out) override {
+        const double step = frequency / block.sampling_freq;
+        const signal_kernels& kernels = active_kernels();
+        size_t i = 0;
+        while (i < out.size()) {
+            const size_t n = block.first + i;
+            const size_t seed = n - n % resync_interval;
+            const size_t end = std::min(out.size(), i + (seed + resync_interval - n));
+            const double cycles = frequency * (double(seed) / block.sampling_freq);
+            kernels.pulse(&out[i], end - i, cycles - floor(cycles), step, n - seed, duty_cycle, amplitude);
+            i = end;
+        }
+    }
+};
+
+class white_signal : public signal {
+private:
+    uint64_t reference_index = 0;  // next sample returned by out()
+
+public:
+    double amplitude;
+    unsigned int seed;  // with the DAQ serial, channel and acquisition index, selects the noise stream
+
+    // Constructor that accepts a seed for reproducibility
+    white_signal(float amplitude, unsigned int seed = std::random_device{}())
+        : amplitude(amplitude), seed(seed) {}
+
+    std::unique_ptr<signal> clone() const override { return std::make_unique<white_signal>(*this); }
+    noise_stream stream(const sample_block& block) const {
+        return noise_stream{ seed, uint32_t(block.daq_serial), uint32_t(block.channel), uint32_t(block.acquisition) };
+    }
+    // Reference path: successive calls return samples 0, 1, 2, ... of acquisition 0
+    double out(double) override {
+        double y;
+        active_kernels().noise(&y, 1, stream(sample_block()), reference_index++, amplitude);
+        return y;
+
+    }
+    // Counter-based, so any block of any acquisition can be generated independently and reproducibly
+    void generate(const sample_block& block, std::span<double> out) override {
+        active_kernels().noise(out.data(), out.size(), stream(block), block.first, amplitude);
+    }
+    void reset() {
+        reference_index = 0;
+    }
+};
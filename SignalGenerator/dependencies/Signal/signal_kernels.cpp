@@ -0,0 +1,526 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "signal_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SG_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles any intrinsic anywhere; GCC and Clang need the instruction set enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SG_TARGET(isa)
+#else
+#define SG_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// GCC 12 reports the _mm512_undefined_* placeholders inside its own AVX-512 headers as uninitialized
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace {
+
+// Cody-Waite split of pi/2: the first two parts have enough trailing zeros that k * part is exact for |k| < 2^29
+const double PIO2_1 = 1.5707962512969970703125;
+const double PIO2_2 = 7.54978941586159635336e-8;
+const double PIO2_3 = 5.39030285815811905290e-15;
+const double TWO_OVER_PI = 0.63661977236758134308;
+// Adding and subtracting 1.5 * 2^52 rounds to the nearest integer and leaves it in the low mantissa bits
+const double ROUND_MAGIC = 6755399441055744.0;
+
+// Minimax polynomials on [-pi/4, pi/4] (Cephes): sin r = r + r^3 * S(r^2), cos r = 1 - r^2/2 + r^4 * C(r^2)
+const double S0 = 1.58962301576546568060e-10, S1 = -2.50507477628578072866e-8, S2 = 2.75573136213857245213e-6;
+const double S3 = -1.98412698295895385996e-4, S4 = 8.33333333332211858878e-3, S5 = -1.66666666666666307295e-1;
+const double C0 = -1.13585365213876817300e-11, C1 = 2.08757008419747316778e-9, C2 = -2.75573141792967388112e-7;
+const double C3 = 2.48015872888517045348e-5, C4 = -1.38888888888730564116e-3, C5 = 4.16666666666665929218e-2;
+
+const size_t SCALAR_RESYNC = 256;
+
+// Scalar sine: recursive oscillator re-seeded from libm every SCALAR_RESYNC samples after the reference
+void sine_scalar(double* out, size_t n, double theta0, double step, size_t offset, double amplitude) {
+    const double cos_step = cos(step);
+    const double sin_step = sin(step);
+    size_t i = 0;
+    while (i < n) {
+        const size_t k = offset + i;
+        const size_t seed = k - k % SCALAR_RESYNC;
+        const size_t end = std::min(n, i + (seed + SCALAR_RESYNC - k));
+        const double theta = theta0 + double(seed) * step;
+        double s = sin(theta);
+        double c = cos(theta);
+        for (size_t j = seed; j < k; j++) {
+            const double s_next = s * cos_step + c * sin_step;
+            c = c * cos_step - s * sin_step;
+            s = s_next;
+        }
+        for (; i < end; i++) {
+            out[i] = amplitude * s;
+            const double s_next = s * cos_step + c * sin_step;
+            c = c * cos_step - s * sin_step;
+            s = s_next;
+        }
+    }
+}
+
+// Top 52 bits of x as a double in [-1, 1): the bits fill the mantissa of a number in [2, 4), then 3 is subtracted
+double to_signed_unit(uint64_t x) {
+    const uint64_t bits = (x >> 12) | 0x4000000000000000ull;
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d - 3.0;
+}
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"): ten rounds of two 32x32->64
+// multiplies; the round keys only depend on the stream key, so they are expanded once per call
+const uint32_t PHILOX_M0 = 0xD2511F53u;
+const uint32_t PHILOX_M1 = 0xCD9E8D57u;
+const int PHILOX_ROUNDS = 10;
+
+struct philox_keys {
+    uint32_t k0[PHILOX_ROUNDS];
+    uint32_t k1[PHILOX_ROUNDS];
+};
+
+philox_keys expand_keys(const noise_stream& stream) {
+    philox_keys keys;
+    uint32_t k0 = stream.seed;
+    uint32_t k1 = stream.daq_serial;
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        keys.k0[r] = k0;
+        keys.k1[r] = k1;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    return keys;
+}
+
+// Counter block m gives stream samples 2m and 2m + 1
+void philox_pair(uint64_t m, const noise_stream& stream, const philox_keys& keys, uint64_t out[2]) {
+    uint32_t c0 = uint32_t(m), c1 = uint32_t(m >> 32), c2 = stream.acquisition, c3 = stream.channel;
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        const uint64_t p0 = uint64_t(PHILOX_M0) * c0;
+        const uint64_t p1 = uint64_t(PHILOX_M1) * c2;
+        c0 = uint32_t(p1 >> 32) ^ c1 ^ keys.k0[r];
+        c1 = uint32_t(p1);
+        c2 = uint32_t(p0 >> 32) ^ c3 ^ keys.k1[r];
+        c3 = uint32_t(p0);
+    }
+    out[0] = (uint64_t(c1) << 32) | c0;
+    out[1] = (uint64_t(c3) << 32) | c2;
+}
+
+// Samples [first, first + n) one at a time; also handles the odd edges of the vector kernels
+void noise_scalar(double* out, size_t n, const noise_stream& stream, uint64_t first, double amplitude) {
+    const philox_keys keys = expand_keys(stream);
+    for (size_t i = 0; i < n;) {
+        const uint64_t k = first + i;
+        uint64_t pair[2];
+        philox_pair(k >> 1, stream, keys, pair);
+        for (uint64_t h = k & 1; h < 2 && i < n; h++, i++) {
+            out[i] = amplitude * to_signed_unit(pair[h]);
+        }
+    }
+}
+
+void pulse_scalar(double* out, size_t n, double cycle0, double step, size_t offset, double duty, double amplitude) {
+    for (size_t i = 0; i < n; i++) {
+        const double u = cycle0 + double(offset + i) * step;
+        out[i] = (u - floor(u) < duty) ? amplitude : 0.0;
+    }
+}
+
+#ifdef SG_X86
+
+// ---- SSE2 ----
+// There is no SSE2 sine: two lanes of the polynomial measured slower than the scalar oscillator.
+
+SG_TARGET("sse2") __m128d to_signed_unit_sse2(__m128i x) {
+    const __m128i bits = _mm_or_si128(_mm_srli_epi64(x, 12), _mm_set1_epi64x(0x4000000000000000ll));
+    return _mm_sub_pd(_mm_castsi128_pd(bits), _mm_set1_pd(3.0));
+}
+
+// Each 64-bit lane holds one 32-bit Philox word, so _mm_mul_epu32 gives the full 32x32->64 product
+SG_TARGET("sse2") void noise_sse2(double* out, size_t n, const noise_stream& stream, uint64_t first, double amplitude) {
+    size_t i = 0;
+    if (first & 1) {
+        noise_scalar(out, std::min<size_t>(1, n), stream, first, amplitude);
+        i = 1;
+    }
+    const philox_keys keys = expand_keys(stream);
+    const __m128i m0 = _mm_set1_epi64x(PHILOX_M0);
+    const __m128i m1 = _mm_set1_epi64x(PHILOX_M1);
+    const __m128i low = _mm_set1_epi64x(0xFFFFFFFFll);
+    const __m128i acquisition = _mm_set1_epi64x(stream.acquisition);
+    const __m128i channel = _mm_set1_epi64x(stream.channel);
+    const __m128i lane = _mm_set_epi64x(1, 0);
+    const __m128d a = _mm_set1_pd(amplitude);
+    for (; i + 4 <= n; i += 4) {
+        const __m128i m = _mm_add_epi64(_mm_set1_epi64x(int64_t((first + i) >> 1)), lane);
+        __m128i c0 = _mm_and_si128(m, low), c1 = _mm_srli_epi64(m, 32), c2 = acquisition, c3 = channel;
+        for (int r = 0; r < PHILOX_ROUNDS; r++) {
+            const __m128i p0 = _mm_mul_epu32(c0, m0);
+            const __m128i p1 = _mm_mul_epu32(c2, m1);
+            c0 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(p1, 32), c1), _mm_set1_epi64x(keys.k0[r]));
+            c1 = _mm_and_si128(p1, low);
+            c2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(p0, 32), c3), _mm_set1_epi64x(keys.k1[r]));
+            c3 = _mm_and_si128(p0, low);
+        }
+        const __m128d even = _mm_mul_pd(a, to_signed_unit_sse2(_mm_or_si128(_mm_slli_epi64(c1, 32), c0)));
+        const __m128d odd = _mm_mul_pd(a, to_signed_unit_sse2(_mm_or_si128(_mm_slli_epi64(c3, 32), c2)));
+        _mm_storeu_pd(out + i, _mm_unpacklo_pd(even, odd));
+        _mm_storeu_pd(out + i + 2, _mm_unpackhi_pd(even, odd));
+    }
+    if (i < n) {
+        noise_scalar(out + i, n - i, stream, first + i, amplitude);
+    }
+}
+
+SG_TARGET("sse2") void pulse_sse2(double* out, size_t n, double cycle0, double step, size_t offset, double duty, double amplitude) {
+    const __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    const __m128d c0 = _mm_set1_pd(cycle0);
+    const __m128d st = _mm_set1_pd(step);
+    const __m128d d = _mm_set1_pd(duty);
+    const __m128d a = _mm_set1_pd(amplitude);
+    const __m128d one = _mm_set1_pd(1.0);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const double k = double(offset + i);
+        const __m128d u = _mm_add_pd(c0, _mm_mul_pd(_mm_set_pd(k + 1, k), st));
+        // floor: round to nearest, then step down where that rounded up
+        __m128d f = _mm_sub_pd(_mm_add_pd(u, magic), magic);
+        f = _mm_sub_pd(f, _mm_and_pd(_mm_cmpgt_pd(f, u), one));
+        _mm_storeu_pd(out + i, _mm_and_pd(_mm_cmplt_pd(_mm_sub_pd(u, f), d), a));
+    }
+    if (i < n) {
+        pulse_scalar(out + i, n - i, cycle0, step, offset + i, duty, amplitude);
+    }
+}
+
+// ---- AVX2 ----
+
+SG_TARGET("avx2,fma") __m256d sin_poly_avx2(__m256d x) {
+    const __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    const __m256d kb = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(TWO_OVER_PI)), magic);
+    const __m256i q = _mm256_castpd_si256(kb);
+    const __m256d k = _mm256_sub_pd(kb, magic);
+    __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(PIO2_1)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(PIO2_2)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(PIO2_3)));
+    const __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d ps = _mm256_set1_pd(S0);
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(S1));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(S2));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(S3));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(S4));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(S5));
+    const __m256d s = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(ps, z), r));
+
+    __m256d pc = _mm256_set1_pd(C0);
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(C1));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(C2));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(C3));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(C4));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(C5));
+    const __m256d c = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(z, _mm256_set1_pd(0.5))),
+                                    _mm256_mul_pd(_mm256_mul_pd(pc, z), z));
+
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256d use_cos = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, one), one));
+    const __m256d v = _mm256_blendv_pd(s, c, use_cos);
+    const __m256d sign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_srli_epi64(q, 1), 63));
+    return _mm256_xor_pd(v, sign);
+}
+
+SG_TARGET("avx2,fma") void sine_avx2(double* out, size_t n, double theta0, double step, size_t offset, double amplitude) {
+    const __m256d a = _mm256_set1_pd(amplitude);
+    const __m256d t0 = _mm256_set1_pd(theta0);
+    const __m256d st = _mm256_set1_pd(step);
+    const __m256d lane = _mm256_set_pd(3, 2, 1, 0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d idx = _mm256_add_pd(_mm256_set1_pd(double(offset + i)), lane);
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(a, sin_poly_avx2(_mm256_add_pd(t0, _mm256_mul_pd(idx, st)))));
+    }
+    if (i < n) {
+        double tmp[4];
+        const __m256d idx = _mm256_add_pd(_mm256_set1_pd(double(offset + i)), lane);
+        _mm256_storeu_pd(tmp, _mm256_mul_pd(a, sin_poly_avx2(_mm256_add_pd(t0, _mm256_mul_pd(idx, st)))));
+        memcpy(out + i, tmp, (n - i) * sizeof(double));
+    }
+}
+
+SG_TARGET("avx2,fma") __m256d to_signed_unit_avx2(__m256i x) {
+    const __m256i bits = _mm256_or_si256(_mm256_srli_epi64(x, 12), _mm256_set1_epi64x(0x4000000000000000ll));
+    return _mm256_sub_pd(_mm256_castsi256_pd(bits), _mm256_set1_pd(3.0));
+}
+
+SG_TARGET("avx2,fma") void noise_avx2(double* out, size_t n, const noise_stream& stream, uint64_t first, double amplitude) {
+    size_t i = 0;
+    if (first & 1) {
+        noise_scalar(out, std::min<size_t>(1, n), stream, first, amplitude);
+        i = 1;
+    }
+    const philox_keys keys = expand_keys(stream);
+    const __m256i m0 = _mm256_set1_epi64x(PHILOX_M0);
+    const __m256i m1 = _mm256_set1_epi64x(PHILOX_M1);
+    const __m256i low = _mm256_set1_epi64x(0xFFFFFFFFll);
+    const __m256i acquisition = _mm256_set1_epi64x(stream.acquisition);
+    const __m256i channel = _mm256_set1_epi64x(stream.channel);
+    const __m256i lane = _mm256_set_epi64x(3, 2, 1, 0);
+    const __m256d a = _mm256_set1_pd(amplitude);
+    for (; i + 8 <= n; i += 8) {
+        const __m256i m = _mm256_add_epi64(_mm256_set1_epi64x(int64_t((first + i) >> 1)), lane);
+        __m256i c0 = _mm256_and_si256(m, low), c1 = _mm256_srli_epi64(m, 32), c2 = acquisition, c3 = channel;
+        for (int r = 0; r < PHILOX_ROUNDS; r++) {
+            const __m256i p0 = _mm256_mul_epu32(c0, m0);
+            const __m256i p1 = _mm256_mul_epu32(c2, m1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c1), _mm256_set1_epi64x(keys.k0[r]));
+            c1 = _mm256_and_si256(p1, low);
+            c2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c3), _mm256_set1_epi64x(keys.k1[r]));
+            c3 = _mm256_and_si256(p0, low);
+        }
+        const __m256d even = _mm256_mul_pd(a, to_signed_unit_avx2(_mm256_or_si256(_mm256_slli_epi64(c1, 32), c0)));
+        const __m256d odd = _mm256_mul_pd(a, to_signed_unit_avx2(_mm256_or_si256(_mm256_slli_epi64(c3, 32), c2)));
+        // unpack gives (e0 o0 e2 o2), (e1 o1 e3 o3); the lane permute restores sample order
+        const __m256d lo = _mm256_unpacklo_pd(even, odd);
+        const __m256d hi = _mm256_unpackhi_pd(even, odd);
+        _mm256_storeu_pd(out + i, _mm256_permute2f128_pd(lo, hi, 0x20));
+        _mm256_storeu_pd(out + i + 4, _mm256_permute2f128_pd(lo, hi, 0x31));
+    }
+    if (i < n) {
+        noise_scalar(out + i, n - i, stream, first + i, amplitude);
+    }
+}
+
+SG_TARGET("avx2,fma") void pulse_avx2(double* out, size_t n, double cycle0, double step, size_t offset, double duty, double amplitude) {
+    const __m256d c0 = _mm256_set1_pd(cycle0);
+    const __m256d st = _mm256_set1_pd(step);
+    const __m256d d = _mm256_set1_pd(duty);
+    const __m256d a = _mm256_set1_pd(amplitude);
+    const __m256d lane = _mm256_set_pd(3, 2, 1, 0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d idx = _mm256_add_pd(_mm256_set1_pd(double(offset + i)), lane);
+        const __m256d u = _mm256_add_pd(c0, _mm256_mul_pd(idx, st));
+        const __m256d frac = _mm256_sub_pd(u, _mm256_floor_pd(u));
+        _mm256_storeu_pd(out + i, _mm256_and_pd(_mm256_cmp_pd(frac, d, _CMP_LT_OQ), a));
+    }
+    if (i < n) {
+        pulse_scalar(out + i, n - i, cycle0, step, offset + i, duty, amplitude);
+    }
+}
+
+// ---- AVX-512 ----
+
+SG_TARGET("avx512f") __m512d sin_poly_avx512(__m512d x) {
+    const __m512d magic = _mm512_set1_pd(ROUND_MAGIC);
+    const __m512d kb = _mm512_add_pd(_mm512_mul_pd(x, _mm512_set1_pd(TWO_OVER_PI)), magic);
+    const __m512i q = _mm512_castpd_si512(kb);
+    const __m512d k = _mm512_sub_pd(kb, magic);
+    __m512d r = _mm512_sub_pd(x, _mm512_mul_pd(k, _mm512_set1_pd(PIO2_1)));
+    r = _mm512_sub_pd(r, _mm512_mul_pd(k, _mm512_set1_pd(PIO2_2)));
+    r = _mm512_sub_pd(r, _mm512_mul_pd(k, _mm512_set1_pd(PIO2_3)));
+    const __m512d z = _mm512_mul_pd(r, r);
+
+    __m512d ps = _mm512_set1_pd(S0);
+    ps = _mm512_add_pd(_mm512_mul_pd(ps, z), _mm512_set1_pd(S1));
+    ps = _mm512_add_pd(_mm512_mul_pd(ps, z), _mm512_set1_pd(S2));
+    ps = _mm512_add_pd(_mm512_mul_pd(ps, z), _mm512_set1_pd(S3));
+    ps = _mm512_add_pd(_mm512_mul_pd(ps, z), _mm512_set1_pd(S4));
+    ps = _mm512_add_pd(_mm512_mul_pd(ps, z), _mm512_set1_pd(S5));
+    const __m512d s = _mm512_add_pd(r, _mm512_mul_pd(_mm512_mul_pd(ps, z), r));
+
+    __m512d pc = _mm512_set1_pd(C0);
+    pc = _mm512_add_pd(_mm512_mul_pd(pc, z), _mm512_set1_pd(C1));
+    pc = _mm512_add_pd(_mm512_mul_pd(pc, z), _mm512_set1_pd(C2));
+    pc = _mm512_add_pd(_mm512_mul_pd(pc, z), _mm512_set1_pd(C3));
+    pc = _mm512_add_pd(_mm512_mul_pd(pc, z), _mm512_set1_pd(C4));
+    pc = _mm512_add_pd(_mm512_mul_pd(pc, z), _mm512_set1_pd(C5));
+    const __m512d c = _mm512_add_pd(_mm512_sub_pd(_mm512_set1_pd(1.0), _mm512_mul_pd(z, _mm512_set1_pd(0.5))),
+                                    _mm512_mul_pd(_mm512_mul_pd(pc, z), z));
+
+    const __mmask8 use_cos = _mm512_test_epi64_mask(q, _mm512_set1_epi64(1));
+    const __m512d v = _mm512_mask_blend_pd(use_cos, s, c);
+    const __m512i sign = _mm512_slli_epi64(_mm512_srli_epi64(q, 1), 63);
+    return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(v), sign));
+}
+
+SG_TARGET("avx512f") void sine_avx512(double* out, size_t n, double theta0, double step, size_t offset, double amplitude) {
+    const __m512d a = _mm512_set1_pd(amplitude);
+    const __m512d t0 = _mm512_set1_pd(theta0);
+    const __m512d st = _mm512_set1_pd(step);
+    const __m512d lane = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0;
+    for (; i < n; i += 8) {
+        const __m512d idx = _mm512_add_pd(_mm512_set1_pd(double(offset + i)), lane);
+        const __m512d v = _mm512_mul_pd(a, sin_poly_avx512(_mm512_add_pd(t0, _mm512_mul_pd(idx, st))));
+        const __mmask8 m = (n - i >= 8) ? __mmask8(0xFF) : __mmask8((1u << (n - i)) - 1);
+        _mm512_mask_storeu_pd(out + i, m, v);
+    }
+}
+
+SG_TARGET("avx512f") __m512d to_signed_unit_avx512(__m512i x) {
+    const __m512i bits = _mm512_or_si512(_mm512_srli_epi64(x, 12), _mm512_set1_epi64(0x4000000000000000ll));
+    return _mm512_sub_pd(_mm512_castsi512_pd(bits), _mm512_set1_pd(3.0));
+}
+
+SG_TARGET("avx512f") void noise_avx512(double* out, size_t n, const noise_stream& stream, uint64_t first, double amplitude) {
+    size_t i = 0;
+    if (first & 1) {
+        noise_scalar(out, std::min<size_t>(1, n), stream, first, amplitude);
+        i = 1;
+    }
+    const philox_keys keys = expand_keys(stream);
+    const __m512i m0 = _mm512_set1_epi64(PHILOX_M0);
+    const __m512i m1 = _mm512_set1_epi64(PHILOX_M1);
+    const __m512i low = _mm512_set1_epi64(0xFFFFFFFFll);
+    const __m512i acquisition = _mm512_set1_epi64(stream.acquisition);
+    const __m512i channel = _mm512_set1_epi64(stream.channel);
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i first_half = _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0);
+    const __m512i second_half = _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4);
+    const __m512d a = _mm512_set1_pd(amplitude);
+    for (; i + 16 <= n; i += 16) {
+        const __m512i m = _mm512_add_epi64(_mm512_set1_epi64(int64_t((first + i) >> 1)), lane);
+        __m512i c0 = _mm512_and_si512(m, low), c1 = _mm512_srli_epi64(m, 32), c2 = acquisition, c3 = channel;
+        for (int r = 0; r < PHILOX_ROUNDS; r++) {
+            const __m512i p0 = _mm512_mul_epu32(c0, m0);
+            const __m512i p1 = _mm512_mul_epu32(c2, m1);
+            c0 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p1, 32), c1), _mm512_set1_epi64(keys.k0[r]));
+            c1 = _mm512_and_si512(p1, low);
+            c2 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p0, 32), c3), _mm512_set1_epi64(keys.k1[r]));
+            c3 = _mm512_and_si512(p0, low);
+        }
+        const __m512d even = _mm512_mul_pd(a, to_signed_unit_avx512(_mm512_or_si512(_mm512_slli_epi64(c1, 32), c0)));
+        const __m512d odd = _mm512_mul_pd(a, to_signed_unit_avx512(_mm512_or_si512(_mm512_slli_epi64(c3, 32), c2)));
+        _mm512_storeu_pd(out + i, _mm512_permutex2var_pd(even, first_half, odd));
+        _mm512_storeu_pd(out + i + 8, _mm512_permutex2var_pd(even, second_half, odd));
+    }
+    if (i < n) {
+        noise_avx2(out + i, n - i, stream, first + i, amplitude);
+    }
+}
+
+SG_TARGET("avx512f") void pulse_avx512(double* out, size_t n, double cycle0, double step, size_t offset, double duty, double amplitude) {
+    const __m512d c0 = _mm512_set1_pd(cycle0);
+    const __m512d st = _mm512_set1_pd(step);
+    const __m512d d = _mm512_set1_pd(duty);
+    const __m512d a = _mm512_set1_pd(amplitude);
+    const __m512d lane = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+    for (size_t i = 0; i < n; i += 8) {
+        const __m512d idx = _mm512_add_pd(_mm512_set1_pd(double(offset + i)), lane);
+        const __m512d u = _mm512_add_pd(c0, _mm512_mul_pd(idx, st));
+        const __m512d frac = _mm512_sub_pd(u, _mm512_roundscale_pd(u, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+        const __mmask8 high = _mm512_cmp_pd_mask(frac, d, _CMP_LT_OQ);
+        const __mmask8 m = (n - i >= 8) ? __mmask8(0xFF) : __mmask8((1u << (n - i)) - 1);
+        _mm512_mask_storeu_pd(out + i, m, _mm512_maskz_mov_pd(high, a));
+    }
+}
+
+void cpuid(int leaf, int subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, leaf, subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = unsigned(r[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+
+simd_level detect() {
+    unsigned r[4];
+    cpuid(0, 0, r);
+    const unsigned max_leaf = r[0];
+    cpuid(1, 0, r);
+    const bool fma = (r[2] & (1u << 12)) != 0;
+    if (!(r[3] & (1u << 26))) {
+        return simd_level::scalar;
+    }
+    // AVX state must be enabled by the OS (OSXSAVE, then XMM and YMM in XCR0)
+    const bool osxsave = (r[2] & (1u << 27)) != 0;
+    if (!osxsave || max_leaf < 7) {
+        return simd_level::sse2;
+    }
+    const unsigned long long xcr0 = xgetbv0();
+    if ((xcr0 & 0x6) != 0x6) {
+        return simd_level::sse2;
+    }
+    cpuid(7, 0, r);
+    const bool avx2 = (r[1] & (1u << 5)) != 0 && fma;
+    const bool avx512f = (r[1] & (1u << 16)) != 0;
+    // AVX-512 also needs opmask, upper ZMM and high ZMM state
+    if (avx512f && (xcr0 & 0xE6) == 0xE6) {
+        return simd_level::avx512;
+    }
+    return avx2 ? simd_level::avx2 : simd_level::sse2;
+}
+
+#else
+
+simd_level detect() {
+    return simd_level::scalar;
+}
+
+#endif
+
+signal_kernels kernels_for(simd_level level) {
+    switch (level) {
+#ifdef SG_X86
+    case simd_level::avx512:
+        return { sine_avx512, noise_avx512, pulse_avx512 };
+    case simd_level::avx2:
+        return { sine_avx2, noise_avx2, pulse_avx2 };
+    case simd_level::sse2:
+        return { sine_scalar, noise_sse2, pulse_sse2 };
+#endif
+    default:
+        return { sine_scalar, noise_scalar, pulse_scalar };
+    }
+}
+
+signal_kernels g_kernels = kernels_for(detected_simd_level());
+simd_level g_level = detected_simd_level();
+
+}  // namespace
+
+simd_level detected_simd_level() {
+    static const simd_level level = detect();
+    return level;
+}
+
+const signal_kernels& active_kernels() {
+    return g_kernels;
+}
+
+simd_level set_simd_level(simd_level level) {
+    g_level = std::min(level, detected_simd_level());
+    g_kernels = kernels_for(g_level);
+    return g_level;
+}
+
+const char* simd_level_name(simd_level level) {
+    switch (level) {
+    case simd_level::avx512: return "AVX-512";
+    case simd_level::avx2:   return "AVX2";
+    case simd_level::sse2:   return "SSE2";
+    default:                 return "scalar";
+    }
+}
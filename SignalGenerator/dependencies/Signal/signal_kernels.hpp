@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Instruction sets the generation kernels are built for, lowest first. avx2 also requires FMA.
+enum class simd_level {
+    scalar = 0,
+    sse2,
+    avx2,
+    avx512
+};
+
+// Identifies one reproducible white noise stream. Sample k of the stream is Philox4x32-10 of the counter
+// (k / 2, acquisition, channel) under the key (seed, daq_serial), so it depends only on these fields and k:
+// any range of samples can be generated on its own, in any order or thread, at any SIMD level, and always
+// gives the same values.
+struct noise_stream {
+    uint32_t seed = 0;
+    uint32_t daq_serial = 0;
+    uint32_t channel = 0;
+    uint32_t acquisition = 0;
+};
+
+// Kernels that fill a block of samples. Sine and pulse take the phase at a reference sample plus a
+// per-sample step, and fill out[i] for sample (offset + i) after that reference, so callers can pin the
+// reference to absolute sample indices and get the same output however a block is split.
+struct signal_kernels {
+    // out[i] = amplitude * sin(theta0 + (offset + i) * step). Scalar and SSE2 use the recursive oscillator
+    // (re-seeded from libm every 256 samples); AVX2 and AVX-512 evaluate a Cody-Waite reduction plus a
+    // degree-13 minimax polynomial per lane, within 2 ulp of libm for |theta| < 2^28, plus the rounding
+    // of the argument itself, so callers should keep theta0 reduced to [0, 2*pi).
+    void (*sine)(double* out, size_t n, double theta0, double step, size_t offset, double amplitude);
+    // out[i] = amplitude * u, u uniform in [-1, 1): samples [first, first + n) of the stream
+    void (*noise)(double* out, size_t n, const noise_stream& stream, uint64_t first, double amplitude);
+    // out[i] = amplitude while frac(cycle0 + (offset + i) * step) < duty, else 0
+    void (*pulse)(double* out, size_t n, double cycle0, double step, size_t offset, double duty, double amplitude);
+};
+
+// Best level supported by this CPU and OS (CPUID + XGETBV), detected once
+simd_level detected_simd_level();
+// Kernels of the active level; defaults to the detected level
+const signal_kernels& active_kernels();
+// Force a level, clamped to the detected one (benchmarks, comparing paths). Not thread safe against running generation.
+simd_level set_simd_level(simd_level level);
+const char* simd_level_name(simd_level level);
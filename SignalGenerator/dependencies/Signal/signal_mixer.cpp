@@ -0,0 +1,134 @@
+#include <algorithm>
+#include "signal_mixer.hpp"
+
+bool signal_mixer::mix(const sample_block& block, size_t samples, std::vector<std::unique_ptr<signal>>& signals, thread_pool* pool) {
+    const bool block_changed = !(block == last_block) || samples != sum.size();
+    bool changed = block_changed || signals.size() != components.size();
+
+    // Line the cache up with the signal list; added, deleted and reordered signals keep their samples, and
+    // touched signals reuse the buffer of a cache entry nobody claimed instead of allocating a new one
+    std::vector<component> cached(signals.size());
+    std::vector<bool> dirty(signals.size(), true);
+    std::vector<bool> claimed(components.size());
+    for (size_t j = 0; j < signals.size(); j++) {
+        const uint64_t version = signals[j]->version();
+        auto it = std::find_if(components.begin(), components.end(),
+            [version](const component& c) { return c.version == version; });
+        cached[j].version = version;
+        if (it != components.end()) {
+            changed |= (it - components.begin()) != std::ptrdiff_t(j);
+            claimed[it - components.begin()] = true;
+            cached[j].samples = std::move(it->samples);
+            dirty[j] = block_changed;
+        }
+        changed |= dirty[j];
+    }
+    size_t spare = 0;
+    for (size_t j = 0; j < signals.size(); j++) {
+        if (!cached[j].samples.empty() || dirty[j] == false) {
+            continue;
+        }
+        while (spare < components.size() && claimed[spare]) {
+            spare++;
+        }
+        if (spare < components.size()) {
+            cached[j].samples = std::move(components[spare++].samples);
+        }
+    }
+    components = std::move(cached);
+    last_block = block;
+    if (!changed) {
+        return false;
+    }
+
+    for (size_t j = 0; j < signals.size(); j++) {
+        components[j].samples.resize(samples);
+    }
+    sum.resize(samples);
+    const size_t chunk = chunk_tiles * tile_size;
+    const size_t chunks = (samples + chunk - 1) / chunk;
+    if (pool && pool->size() > 1 && chunks > 1) {
+        pool->parallel_for(chunks, [&](size_t c) {
+            mix_tiles(block, c * chunk, std::min(samples, (c + 1) * chunk), signals, dirty);
+        });
+    }
+    else {
+        mix_tiles(block, 0, samples, signals, dirty);
+    }
+    return true;
+}
+
+// Tiles of [begin, end); begin is a multiple of tile_size
+void signal_mixer::mix_tiles(const sample_block& block, size_t begin, size_t end, std::vector<std::unique_ptr<signal>>& signals, const std::vector<bool>& dirty) {
+    for (size_t t = begin; t < end; t += tile_size) {
+        const size_t n = std::min(tile_size, end - t);
+        sample_block tile = block;
+        tile.first = block.first + t;
+        for (size_t j = 0; j < signals.size(); j++) {
+            if (dirty[j]) {
+                signals[j]->generate(tile, std::span<double>(components[j].samples).subspan(t, n));
+            }
+        }
+        sum_tile(t, n);
+    }
+}
+
+namespace {
+
+// y = c0 + c1 + c2 + c3 (or y +=, after the first group) in one pass over the tile
+void add_group(double* y, const double* c0, const double* c1, const double* c2, const double* c3, size_t n, bool first) {
+    if (first) {
+        for (size_t i = 0; i < n; i++) {
+            y[i] = (c0[i] + c1[i]) + (c2[i] + c3[i]);
+        }
+    }
+    else {
+        for (size_t i = 0; i < n; i++) {
+            y[i] += (c0[i] + c1[i]) + (c2[i] + c3[i]);
+        }
+    }
+}
+
+const double zeros[signal_mixer::tile_size] = {};  // stands in for missing members of the last group
+
+} // namespace
+
+void signal_mixer::sum_tile(size_t t, size_t n) {
+    double* y = &sum[t];
+    if (components.empty()) {
+        std::fill(y, y + n, 0.0);
+        return;
+    }
+    for (size_t j = 0; j < components.size(); j += 4) {
+        const double* c0 = &components[j].samples[t];
+        const double* c1 = j + 1 < components.size() ? &components[j + 1].samples[t] : zeros;
+        const double* c2 = j + 2 < components.size() ? &components[j + 2].samples[t] : zeros;
+        const double* c3 = j + 3 < components.size() ? &components[j + 3].samples[t] : zeros;
+        add_group(y, c0, c1, c2, c3, n, j == 0);
+    }
+}
+
+void mix_signals(const sample_block& block, const std::vector<std::unique_ptr<signal>>& signals, std::span<double> sum) {
+    double scratch[4][signal_mixer::tile_size];
+    for (size_t t = 0; t < sum.size(); t += signal_mixer::tile_size) {
+        const size_t n = std::min(signal_mixer::tile_size, sum.size() - t);
+        sample_block tile = block;
+        tile.first = block.first + t;
+        if (signals.empty()) {
+            std::fill(&sum[t], &sum[t] + n, 0.0);
+        }
+        for (size_t j = 0; j < signals.size(); j += 4) {
+            const double* c[4];
+            for (size_t k = 0; k < 4; k++) {
+                if (j + k < signals.size()) {
+                    signals[j + k]->generate(tile, std::span<double>(scratch[k], n));
+                    c[k] = scratch[k];
+                }
+                else {
+                    c[k] = zeros;
+                }
+            }
+            add_group(&sum[t], c[0], c[1], c[2], c[3], n, j == 0);
+        }
+    }
+}
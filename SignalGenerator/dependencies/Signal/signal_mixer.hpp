@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "signal.hpp"
+#include "thread_pool.hpp"
+
+// Generates every component and their sum in one pass over L1-sized tiles: each component fills its tile,
+// then the tile sum is formed four components at a time in registers and written once. The per-component
+// samples are kept as the panel previews, so nothing is generated twice per frame.
+// Components are cached by signal version: mix() regenerates only signals that were touched (or all of them
+// when the block changes) and re-sums only when something changed.
+// Long acquisitions are split into chunks of whole tiles and filled on a thread_pool. Every kernel depends
+// only on absolute sample indices, so the result is bit-identical for any thread count.
+class signal_mixer {
+public:
+    static constexpr size_t tile_size = 512;  // 4 KiB per component; a multiple of the kernels' 256-sample segments
+    static constexpr size_t chunk_tiles = 64; // tiles per parallel work item (256 KiB per component)
+    struct component {
+        uint64_t version = 0;  // version of the signal the samples were generated from
+        std::vector<double> samples;
+    };
+    std::vector<component> components;
+    std::vector<double> sum;
+
+    // Returns true when the sum changed. Without a pool (or with a single-thread one) everything runs inline.
+    bool mix(const sample_block& block, size_t samples, std::vector<std::unique_ptr<signal>>& signals, thread_pool* pool = nullptr);
+
+private:
+    void mix_tiles(const sample_block& block, size_t begin, size_t end, std::vector<std::unique_ptr<signal>>& signals, const std::vector<bool>& dirty);
+    void sum_tile(size_t t, size_t n);
+
+    sample_block last_block;
+};
+
+// Sum of the signals over the block with no cache and no per-component buffers, only four tiles of scratch on
+// the stack: for callers that generate many channels at once. Same tiling, and the same samples, as
+// signal_mixer. Only calls generate(), which leaves the signals unchanged, so several threads may share them.
+void mix_signals(const sample_block& block, const std::vector<std::unique_ptr<signal>>& signals, std::span<double> sum);
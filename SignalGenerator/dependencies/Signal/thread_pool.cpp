@@ -0,0 +1,65 @@
+#include "thread_pool.hpp"
+
+thread_pool::thread_pool(size_t threads) {
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void thread_pool::parallel_for(size_t count, const std::function<void(size_t)>& task) {
+    if (workers.empty() || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &task;
+        job_count = count;
+        next = 0;
+        active = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    run_items();
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return active == 0; });
+    job = nullptr;
+}
+
+void thread_pool::run_items() {
+    for (size_t i = next++; i < job_count; i = next++) {
+        (*job)(i);
+    }
+}
+
+void thread_pool::worker_loop() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        run_items();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active == 0) {
+            finished.notify_one();
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Fixed set of worker threads for data-parallel loops. The calling thread works too, so a pool of
+// size() == 1 has no workers and runs everything inline.
+class thread_pool {
+public:
+    explicit thread_pool(size_t threads = std::thread::hardware_concurrency());
+    ~thread_pool();
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Threads that take part in parallel_for, including the caller
+    size_t size() const { return workers.size() + 1; }
+    // Runs task(i) for every i in [0, count) and returns when all calls are done. Indices are handed out
+    // one at a time, so uneven items balance themselves. Not reentrant.
+    void parallel_for(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    void worker_loop();
+    void run_items();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* job = nullptr;
+    size_t job_count = 0;
+    uint64_t generation = 0;  // bumped per parallel_for so workers see each job once
+    size_t active = 0;        // workers still inside the current job
+    std::atomic<size_t> next{ 0 };
+    bool stopping = false;
+};
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include "timer_wheel.hpp"
+
+timer_wheel::timer_wheel(uint64_t tick_ns, uint64_t start_ns)
+    : tick_ns(tick_ns ? tick_ns : 1), start_ns(start_ns) {}
+
+void timer_wheel::add(uint64_t deadline_ns, uint64_t id) {
+    place(timer{ deadline_ns, id });
+    count++;
+}
+
+void timer_wheel::place(const timer& t) {
+    uint64_t tick = t.deadline < start_ns ? 0 : (t.deadline - start_ns) / tick_ns;
+    tick = std::max(tick, current_tick);
+    const uint64_t delta = tick - current_tick;
+    int level = 0;
+    while (level < levels - 1 && delta >= (uint64_t(1) << (slot_bits * (level + 1)))) {
+        level++;
+    }
+    // Beyond the top level's span: park it at the far end, it is placed again when that slot is spread out
+    const uint64_t horizon = uint64_t(1) << (slot_bits * levels);
+    if (delta >= horizon) {
+        tick = current_tick + horizon - 1;
+    }
+    wheel[level][(tick >> (slot_bits * level)) & (slots - 1)].push_back(t);
+    level_count[level]++;
+}
+
+// Moves the slot of this level that starts at current_tick down to the lower levels
+void timer_wheel::cascade(int level) {
+    std::vector<timer> moving;
+    moving.swap(wheel[level][(current_tick >> (slot_bits * level)) & (slots - 1)]);
+    level_count[level] -= moving.size();
+    for (const timer& t : moving) {
+        place(t);
+    }
+}
+
+void timer_wheel::expire(uint64_t now_ns, std::vector<timer>& fired) {
+    const size_t first = fired.size();
+    const uint64_t target = now_ns < start_ns ? 0 : (now_ns - start_ns) / tick_ns;
+    // The wheel stops on the tick of now_ns rather than past it, so timers added later for this same tick
+    // (or already overdue) still land in a slot that is looked at again
+    while (current_tick <= target) {
+        if (count == 0) {
+            current_tick = target;
+            break;
+        }
+        if (cascaded_tick != current_tick) {
+            // Highest level first, so a slot spread into the level below is spread again right away
+            for (int level = levels - 1; level >= 1; level--) {
+                const uint64_t span = uint64_t(1) << (slot_bits * level);
+                if (current_tick % span == 0 && level_count[level] > 0) {
+                    cascade(level);
+                }
+            }
+            cascaded_tick = current_tick;
+        }
+        std::vector<timer>& slot = wheel[0][current_tick & (slots - 1)];
+        size_t kept = 0;
+        for (const timer& t : slot) {
+            if (t.deadline <= now_ns) {
+                fired.push_back(t);
+            }
+            else {
+                slot[kept++] = t;
+            }
+        }
+        level_count[0] -= slot.size() - kept;
+        count -= slot.size() - kept;
+        slot.resize(kept);
+        if (kept > 0 || current_tick == target) {
+            break;  // the rest are due later in this tick, or this is the tick of now_ns
+        }
+        current_tick++;
+    }
+    std::sort(fired.begin() + first, fired.end(), [](const timer& a, const timer& b) { return a.deadline < b.deadline; });
+}
+
+uint64_t timer_wheel::next_wakeup() const {
+    if (count == 0) {
+        return UINT64_MAX;
+    }
+    uint64_t wakeup = UINT64_MAX;
+    for (size_t i = 0; i < slots; i++) {
+        const std::vector<timer>& slot = wheel[0][(current_tick + i) & (slots - 1)];
+        if (!slot.empty()) {
+            for (const timer& t : slot) {
+                wakeup = std::min(wakeup, t.deadline);
+            }
+            break;
+        }
+    }
+    if (count > level_count[0]) {
+        // Timers on higher levels may be earlier than anything on level 0 once they come down
+        uint64_t boundary = (current_tick + slots - 1) / slots * slots;
+        if (boundary == cascaded_tick) {
+            boundary += slots;
+        }
+        wakeup = std::min(wakeup, start_ns + boundary * tick_ns);
+    }
+    return wakeup;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timer wheel over absolute deadlines in nanoseconds. Level 0 has one slot per tick for the
+// next 256 ticks, each higher level covers 256 times the span of the one below, and a slot of a higher level
+// is spread over the lower levels when the wheel reaches it. Adding is O(1) however many timers are pending,
+// and timers fire at their exact deadline, not at tick granularity: the tick only decides where they wait.
+class timer_wheel {
+public:
+    struct timer {
+        uint64_t deadline;  // ns, on whatever clock the caller uses
+        uint64_t id;
+    };
+    static constexpr int levels = 4;
+    static constexpr int slot_bits = 8;
+    static constexpr size_t slots = size_t(1) << slot_bits;
+
+    // Ticks count from 0, so start_ns should be close to the first deadlines
+    explicit timer_wheel(uint64_t tick_ns = 1000000, uint64_t start_ns = 0);
+
+    // A deadline in the past fires on the next expire()
+    void add(uint64_t deadline_ns, uint64_t id);
+    // Appends every timer with deadline <= now_ns to fired, earliest first
+    void expire(uint64_t now_ns, std::vector<timer>& fired);
+    // When expire() next has something to do: the earliest deadline, or the next time a higher level is due
+    // to be spread out. UINT64_MAX when empty.
+    uint64_t next_wakeup() const;
+    size_t size() const { return count; }
+
+private:
+    void place(const timer& t);
+    void cascade(int level);
+
+    std::vector<timer> wheel[levels][slots];
+    size_t level_count[levels] = {};
+    uint64_t tick_ns;
+    uint64_t start_ns;
+    uint64_t current_tick = 0;  // tick expire() looks at first; every earlier tick is done
+    uint64_t cascaded_tick = UINT64_MAX;  // tick whose higher-level slots were last spread out
+    size_t count = 0;
+};
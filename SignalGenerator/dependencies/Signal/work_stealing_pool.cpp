@@ -0,0 +1,96 @@
+#include "work_stealing_pool.hpp"
+
+namespace {
+// Which pool and deque the current thread works for, so tasks submitted from a task stay local
+thread_local const work_stealing_pool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+}
+
+work_stealing_pool::work_stealing_pool(size_t threads) {
+    threads = threads ? threads : 1;
+    for (size_t i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<task_queue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+work_stealing_pool::~work_stealing_pool() {
+    wait_idle();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void work_stealing_pool::submit(std::function<void()> task) {
+    const size_t index = current_pool == this ? current_index : next_queue++ % queues.size();
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counted under the pool mutex so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(mutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+void work_stealing_pool::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+}
+
+// Newest task of the own deque, else the oldest task of the next non-empty deque
+bool work_stealing_pool::take(size_t index, std::function<void()>& task) {
+    {
+        task_queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < queues.size(); k++) {
+        task_queue& victim = *queues[(index + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steal_count++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_stealing_pool::worker_loop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    std::function<void()> task;
+    while (true) {
+        if (take(index, task)) {
+            queued--;
+            task();
+            task = nullptr;
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                idle.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
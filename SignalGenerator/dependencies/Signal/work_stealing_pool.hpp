@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Fixed set of worker threads for independent tasks (one per DAQ channel acquisition, say). Every worker has
+// its own deque: it runs its newest task first and, when it runs dry, steals the oldest task of another
+// worker, so a burst of tasks submitted to one queue still spreads over all cores. Unlike thread_pool the
+// caller does not take part; submit() returns at once.
+class work_stealing_pool {
+public:
+    explicit work_stealing_pool(size_t threads = std::thread::hardware_concurrency());
+    ~work_stealing_pool();
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    size_t size() const { return workers.size(); }
+    // From one of this pool's workers the task goes to that worker's deque, otherwise queues take turns
+    void submit(std::function<void()> task);
+    // Blocks until every task submitted so far (and any they submitted) has finished
+    void wait_idle();
+    // Tasks a worker took from another worker's deque
+    uint64_t steals() const { return steal_count; }
+
+private:
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void worker_loop(size_t index);
+    bool take(size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::atomic<size_t> queued{ 0 };   // tasks sitting in a deque
+    std::atomic<size_t> pending{ 0 };  // tasks submitted and not finished
+    std::atomic<size_t> next_queue{ 0 };
+    std::atomic<uint64_t> steal_count{ 0 };
+    bool stopping = false;
+};
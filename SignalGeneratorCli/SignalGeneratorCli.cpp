@@ -0,0 +1,193 @@
+// Headless signal generator: runs the periodic acquisitions of every DAQ and channel of a scenario file on a
+// shared worker pool and reports throughput. Never touches ImGui or DirectX.
+// Usage: SignalGeneratorCli <scenario file> [--acquisitions N] [--threads N] [--writers N] [--queue N] [--drop]
+//                           [--backend stream|posix|mmap|direct] [--preallocate] [--msync none|async|sync] [--fsync none|file|group] [--format v3|v4] [--layout planar|interleaved] [--chunk N] [--encoding float64|float32|int16|int24] [--compress] [--compress-threads N] [--no-wait] [--no-write] [--report S]
+//   --acquisitions N  overrides the scenario's acquisition count per DAQ (0 runs until killed)
+//   --threads N       worker threads (default: all cores)
+//   --writers N       writer threads (default 2)
+//   --queue N         channel acquisitions that may wait for a writer (default: two per worker thread)
+//   --drop            drop acquisitions when the write queue is full instead of stalling the workers
+//   --backend B       how files are written: stream (std::ofstream), posix (gathered writev, the default) or mmap
+//                     (generated straight into the mapped file, without writer threads) or direct (Linux:
+//                     O_DIRECT through a shared io_uring, bypassing the page cache)
+//   --preallocate     reserve each file's final size before writing it
+//   --msync P         with mmap, push each file to disk on close: none (default), async or sync
+//   --fsync P         before a finished .temp file is renamed to .bin: none (default), file (fsync the file and its
+//                     folder) or group (the same, batched over the files closed at the same time)
+//   --format F        v3 (default): one file per channel; v4: one file per acquisition holding every channel
+//   --layout L        v4 samples: planar (channel after channel, the default) or interleaved (frame after frame)
+//   --chunk N         v4: cut the samples into chunks of N per channel, each with a CRC-32C in an index at the end
+//   --encoding E      how samples are stored: float64 (default), float32, or int16/int24 counts scaled so that
+//                     +-10 / sensitivity is full scale
+//   --compress        v4: compress each chunk losslessly (chunks of 16384 samples per channel unless --chunk says)
+//   --compress-threads N  threads compressing the chunks of each file, per writer (default 1)
+//   --no-wait         start each DAQ's next acquisition as soon as its last one is written, to measure throughput.
+//                     Files are still named after each acquisition's scheduled time, start + k * interval.
+//   --no-write        generate only
+//   --report S        print running totals every S seconds (default 10)
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "scenario.hpp"
+#include "multi_daq_engine.hpp"
+
+namespace {
+
+int usage() {
+    fprintf(stderr, "usage: SignalGeneratorCli <scenario file> [--acquisitions N] [--threads N] [--writers N] [--queue N] [--drop] "
+        "[--backend stream|posix|mmap|direct] [--preallocate] [--msync none|async|sync] [--fsync none|file|group] [--format v3|v4] [--layout planar|interleaved] [--chunk N] [--encoding float64|float32|int16|int24] [--compress] [--compress-threads N] [--no-wait] [--no-write] [--report S]\n");
+    return 2;
+}
+
+void print_stats(const char* label, const multi_daq_engine::statistics& s, double seconds) {
+    printf("%s %.1f s: %llu acquisitions, %llu overruns, %llu files, generate %.1f Msamples/s per core, write %.1f MB/s per core, "
+        "release lateness p99 <= %.0f us, completion mean %.1f ms max %.1f ms, %llu steals, "
+        "write queue %zu (max %zu), %llu stalls (%.2f s), %llu dropped\n",
+        label, seconds, (unsigned long long)s.acquisitions, (unsigned long long)s.overruns, (unsigned long long)s.files,
+        s.generate_seconds > 0 ? double(s.samples) / s.generate_seconds / 1e6 : 0.0,
+        s.write_seconds > 0 ? double(s.bytes) / s.write_seconds / 1e6 : 0.0,
+        s.release_lateness.quantile_us(0.99), s.completion.mean_us() / 1e3, s.completion.max_us / 1e3,
+        (unsigned long long)s.steals, s.writer.depth, s.writer.max_depth, (unsigned long long)s.writer.stalls,
+        s.writer.stall_seconds, (unsigned long long)s.writer.dropped);
+    fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        return usage();
+    }
+    scenario sc;
+    std::string error;
+    if (!load_scenario(argv[1], sc, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    multi_daq_engine::run_options options;
+    options.acquisitions = sc.acquisitions;
+    int report_seconds = 10;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--acquisitions") == 0 && i + 1 < argc) {
+            options.acquisitions = size_t(atoll(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--writers") == 0 && i + 1 < argc) {
+            options.writers = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            options.queue_depth = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (!parse_file_backend(argv[++i], options.file.backend)) {
+                return usage();
+            }
+        }
+        else if (strcmp(argv[i], "--msync") == 0 && i + 1 < argc) {
+            if (!parse_msync_policy(argv[++i], options.file.msync)) {
+                return usage();
+            }
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char* format = argv[++i];
+            if (strcmp(format, "v3") == 0) {
+                options.file.version = 3;
+            }
+            else if (strcmp(format, "v4") == 0) {
+                options.file.version = 4;
+            }
+            else {
+                return usage();
+            }
+        }
+        else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+            if (!parse_sample_layout(argv[++i], options.file.layout)) {
+                return usage();
+            }
+        }
+        else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            options.file.chunk_frames = size_t(std::max(0, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--encoding") == 0 && i + 1 < argc) {
+            if (!parse_sample_encoding(argv[++i], options.file.encoding)) {
+                return usage();
+            }
+        }
+        else if (strcmp(argv[i], "--compress-threads") == 0 && i + 1 < argc) {
+            options.compress_threads = size_t(std::max(1, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--compress") == 0) {
+            options.file.compress = true;
+        }
+        else if (strcmp(argv[i], "--fsync") == 0 && i + 1 < argc) {
+            if (!parse_fsync_policy(argv[++i], options.file.fsync)) {
+                return usage();
+            }
+        }
+        else if (strcmp(argv[i], "--preallocate") == 0) {
+            options.file.preallocate = true;
+        }
+        else if (strcmp(argv[i], "--drop") == 0) {
+            options.drop_when_full = true;
+        }
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            report_seconds = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--no-wait") == 0) {
+            options.wait = false;
+        }
+        else if (strcmp(argv[i], "--no-write") == 0) {
+            options.write = false;
+        }
+        else {
+            return usage();
+        }
+    }
+
+    size_t channels = 0;
+    for (const auto& group : sc.groups) {
+        channels += group.serials.size() * group.channels.size();
+    }
+    printf("%zu DAQs, %zu channels in %zu groups, %zu threads, kernels: %s, files: %s\n",
+        sc.daq_count(), channels, sc.groups.size(), threads, simd_level_name(detected_simd_level()),
+        options.write ? file_backend_name(options.file.backend) : "none");
+
+    multi_daq_engine engine(sc.make_daqs(), threads);
+    const auto start = std::chrono::steady_clock::now();
+    auto seconds = [&start] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+    // Running totals from a side thread; run() blocks until the acquisitions are done
+    std::mutex report_mutex;
+    std::condition_variable report_wake;
+    bool finished = false;
+    std::thread reporter([&] {
+        std::unique_lock<std::mutex> lock(report_mutex);
+        while (!report_wake.wait_for(lock, std::chrono::seconds(report_seconds), [&] { return finished; })) {
+            print_stats("at", engine.stats(), seconds());
+        }
+    });
+    const bool ran = engine.run(options);
+    {
+        std::lock_guard<std::mutex> lock(report_mutex);
+        finished = true;
+    }
+    report_wake.notify_one();
+    reporter.join();
+    if (!ran) {
+        fprintf(stderr, "cannot schedule acquisitions: %s\n", engine.error().c_str());
+        return 1;
+    }
+    const multi_daq_engine::statistics totals = engine.stats();
+    print_stats("total", totals, seconds());
+    totals.release_lateness.print(stdout, "release lateness (deadline to acquisition start)");
+    totals.completion.print(stdout, "completion (deadline to last channel written)");
+    return 0;
+}
@@ -0,0 +1,162 @@
+// Compression ratio and speed of the PDAT chunk codec.
+// Usage: codec [samples=1048576] [sampling_freq=25600] [data_folder=./codec_data] [max_threads=hardware_concurrency]
+// Generates synthetic machine signals with the signal generator (a shaft's harmonics, a pulse train, both with
+// white noise on top, and the noise alone), stores each in every sample encoding and compresses it in chunks of
+// 16384 samples the way BinaryFile does, checking that it decompresses to the same bytes. Reports the ratio of
+// stored to compressed bytes and the compress and decompress MB/s of stored bytes, best of a few rounds.
+// Then writes the noisy signal as a compressed 4-channel v4 file with its chunks compressed on 1, 2, 4... threads,
+// and opens it with BinaryFileReader on as many, reporting MB/s of the samples as doubles.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "binary_file.hpp"
+#include "binary_file_reader.hpp"
+#include "signal.hpp"
+#include "signal_mixer.hpp"
+#include "thread_pool.hpp"
+#include "sample_codec.hpp"
+#include "sample_encoding.hpp"
+
+namespace {
+
+const size_t chunk_samples = 16384;
+
+struct machine_signal {
+    const char* name;
+    std::vector<std::unique_ptr<signal>> components;
+};
+
+template <typename F>
+double best_seconds(F&& run) {
+    double best = 1e300;
+    for (int round = 0; round < 5; round++) {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t samples = argc > 1 ? size_t(atoll(argv[1])) : size_t(1) << 20;
+    const int sampling_freq = argc > 2 ? atoi(argv[2]) : 25600;
+    const std::string folder = argc > 3 ? argv[3] : "./codec_data";
+    const size_t max_threads = argc > 4 ? size_t(atoi(argv[4])) : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<machine_signal> signals(4);
+    signals[0].name = "harmonics";
+    signals[0].components.push_back(std::make_unique<sin_signal>(50.0f, 0.0f, 1.0f));
+    signals[0].components.push_back(std::make_unique<sin_signal>(100.0f, 0.5f, 0.3f));
+    signals[0].components.push_back(std::make_unique<sin_signal>(150.0f, 1.0f, 0.1f));
+    signals[0].components.push_back(std::make_unique<sin_signal>(1375.0f, 0.2f, 0.05f));
+    signals[1].name = "pulse";
+    signals[1].components.push_back(std::make_unique<pulse_train>(25.0f, 0.05f, 1.0f));
+    signals[2].name = "harm+pulse+noise";
+    signals[2].components.push_back(std::make_unique<sin_signal>(50.0f, 0.0f, 1.0f));
+    signals[2].components.push_back(std::make_unique<sin_signal>(100.0f, 0.5f, 0.3f));
+    signals[2].components.push_back(std::make_unique<pulse_train>(25.0f, 0.05f, 0.5f));
+    signals[2].components.push_back(std::make_unique<white_signal>(0.01f, 1u));
+    signals[3].name = "noise";
+    signals[3].components.push_back(std::make_unique<white_signal>(1.0f, 2u));
+
+    sample_block block;
+    block.sampling_freq = sampling_freq;
+    std::vector<double> y(samples);
+    printf("%zu samples at %d Hz in chunks of %zu, unpack kernels: %s\n", samples, sampling_freq, chunk_samples,
+        sample_codec_kernels());
+    printf("  signal             encoding   ratio   compress MB/s   decompress MB/s\n");
+    for (const machine_signal& s : signals) {
+        mix_signals(block, s.components, y);
+        for (int e = int(sample_encoding::float64); e <= int(sample_encoding::int24); e++) {
+            const sample_encoding encoding = sample_encoding(e);
+            const size_t sample_bytes = encoded_size(encoding);
+            std::vector<unsigned char> stored(samples * sample_bytes);
+            encode_samples(encoding, y.data(), samples, 1.0 / encoding_scale(encoding, 10, 1), stored.data());
+
+            std::vector<unsigned char> compressed;
+            std::vector<size_t> ends;
+            const double compress_seconds = best_seconds([&] {
+                compressed.clear();
+                ends.clear();
+                for (size_t first = 0; first < samples; first += chunk_samples) {
+                    const size_t n = std::min(chunk_samples, samples - first);
+                    compress_samples(encoding, stored.data() + first * sample_bytes, n, compressed);
+                    ends.push_back(compressed.size());
+                }
+            });
+            std::vector<unsigned char> back(stored.size());
+            bool ok = true;
+            const double decompress_seconds = best_seconds([&] {
+                size_t start = 0;
+                for (size_t chunk = 0; chunk < ends.size(); chunk++) {
+                    const size_t first = chunk * chunk_samples;
+                    const size_t n = std::min(chunk_samples, samples - first);
+                    ok &= decompress_samples(encoding, compressed.data() + start, ends[chunk] - start, n, back.data() + first * sample_bytes);
+                    start = ends[chunk];
+                }
+            });
+            if (!ok || back != stored) {
+                fprintf(stderr, "%s %s: decompressed samples differ\n", s.name, sample_encoding_name(encoding));
+                return 1;
+            }
+            const double mb = double(stored.size()) / 1e6;
+            printf("  %-18s %-8s %7.2f %15.0f %17.0f\n", s.name, sample_encoding_name(encoding),
+                double(stored.size()) / double(std::max<size_t>(compressed.size(), 1)), mb / compress_seconds, mb / decompress_seconds);
+        }
+    }
+
+    // Whole files: the noisy signal on four channels, each channel a different stretch of it
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+    ACQCONFIG config;
+    config.daq_serial_number = 1;
+    config.sampling_freq = sampling_freq;
+    config.acq_duration = 1;
+    config.acq_interval = 1;
+    for (int c = 0; c < 4; c++) {
+        config.channels[c].status = 1;
+        config.channels[c].sensor_type = 1;
+        config.channels[c].sensitivity = 1;
+    }
+    std::vector<double> planar(samples * 4);
+    block.first = 0;
+    mix_signals(block, signals[2].components, planar);
+    printf("4-channel compressed files of %zu samples per channel\n", samples);
+    printf("  encoding   threads   write MB/s   open MB/s\n");
+    // Every round writes a new file, and BinaryFile refuses a name that is taken: one acquisition second apiece
+    time_t acquired = time(0);
+    for (sample_encoding encoding : { sample_encoding::float64, sample_encoding::int16 }) {
+        file_options options;
+        options.version = 4;
+        options.encoding = encoding;
+        options.compress = true;
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            thread_pool pool(threads);
+            std::string path;
+            const double write_seconds = best_seconds([&] {
+                BinaryFile file(folder, config, options, acquired++);
+                path = file.file_name_location;
+                file.writeAcquisition(planar.data(), samples, &pool);
+            });
+            BinaryFileReader reader;
+            const double open_seconds = best_seconds([&] { reader.open(path, &pool); });
+            if (!reader.isOpen()) {
+                fprintf(stderr, "%s\n", reader.error().c_str());
+                return 1;
+            }
+            const double mb = double(planar.size() * sizeof(double)) / 1e6;
+            printf("  %-8s %9zu %12.0f %11.0f\n", sample_encoding_name(encoding), threads, mb / write_seconds, mb / open_seconds);
+        }
+    }
+    std::filesystem::remove_all(folder, ec);
+    return 0;
+}
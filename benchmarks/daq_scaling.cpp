@@ -0,0 +1,102 @@
+// How many simultaneous virtual DAQs one box sustains.
+// Usage: daq_scaling [data_folder=./daq_scaling_data] [sampling_freq=20000] [threads=hardware_concurrency] [--no-write]
+//                    [--backend stream|posix|mmap|direct]
+// Runs 1, 2, 4, ... DAQs x 4 channels acquiring continuously (1 s acquisitions every second, 4 components) on
+// multi_daq_engine for three acquisitions each, and stops at the first count that overruns or finishes an
+// acquisition later than its interval. Files are deleted after every step.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "multi_daq_engine.hpp"
+
+namespace {
+
+std::vector<virtual_daq> make_daqs(size_t count, int sampling_freq, const std::string& folder) {
+    std::vector<virtual_daq> daqs(count);
+    for (size_t d = 0; d < count; d++) {
+        virtual_daq& daq = daqs[d];
+        daq.config.daq_serial_number = int(d + 1);
+        daq.config.acq_interval = 1;
+        daq.config.acq_duration = 1;
+        daq.config.sampling_freq = sampling_freq;
+        daq.config.parse_status = 0;
+        daq.config.start_channel = 0;
+        daq.config.channel_count = 4;
+        for (auto& channel : daq.config.channels) {
+            channel.status = 1;
+            channel.sensitivity = 1;
+            channel.sensor_type = 1;
+        }
+        daq.duration = 1;
+        daq.data_folder = folder;
+        daq.signals.push_back(std::make_unique<sin_signal>(50.0f + float(d), 0.0f, 1.0f));
+        daq.signals.push_back(std::make_unique<sin_signal>(150.0f, 0.5f, 0.2f));
+        daq.signals.push_back(std::make_unique<pulse_train>(25.0f, 0.05f, 1.0f));
+        daq.signals.push_back(std::make_unique<white_signal>(0.1f, 1u));
+    }
+    return daqs;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<const char*> args;
+    bool write = true;
+    file_options file;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-write") == 0) {
+            write = false;
+        }
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (!parse_file_backend(argv[++i], file.backend)) {
+                fprintf(stderr, "unknown backend %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else {
+            args.push_back(argv[i]);
+        }
+    }
+    const std::string folder = args.size() > 0 ? args[0] : "./daq_scaling_data";
+    const int sampling_freq = args.size() > 1 ? atoi(args[1]) : 20000;
+    const size_t threads = args.size() > 2 ? size_t(atoi(args[2])) : std::max(1u, std::thread::hardware_concurrency());
+
+    printf("4 channels x %d Hz per DAQ, 1 s acquisitions every second, %zu threads, kernels: %s, files: %s\n",
+        sampling_freq, threads, simd_level_name(detected_simd_level()), write ? file_backend_name(file.backend) : "none");
+    printf("   DAQs  channels  Msamples/s  overruns  release p99 us  completion mean ms  max ms  steals  max queue  stalls\n");
+    size_t sustained = 0;
+    for (size_t count = 1;; count *= 2) {
+        multi_daq_engine::statistics s;
+        {
+            multi_daq_engine engine(make_daqs(count, sampling_freq, folder), threads);
+            multi_daq_engine::run_options options;
+            options.acquisitions = 3;
+            options.write = write;
+            options.file = file;
+            if (!engine.run(options)) {
+                fprintf(stderr, "cannot schedule acquisitions: %s\n", engine.error().c_str());
+                return 1;
+            }
+            s = engine.stats();
+        }
+        std::error_code ec;
+        std::filesystem::remove_all(folder, ec);
+        const bool ok = s.overruns == 0 && s.completion.max_us < 1e6;
+        printf("%7zu  %8zu  %10.1f  %8llu  %14.0f  %18.1f  %6.1f  %6llu  %9zu  %6llu%s\n",
+            count, count * 4, double(count * 4) * sampling_freq / 1e6, (unsigned long long)s.overruns,
+            s.release_lateness.quantile_us(0.99), s.completion.mean_us() / 1e3, s.completion.max_us / 1e3,
+            (unsigned long long)s.steals, s.writer.max_depth, (unsigned long long)s.writer.stalls, ok ? "" : "  (not sustained)");
+        fflush(stdout);
+        if (!ok) {
+            break;
+        }
+        sustained = count;
+    }
+    printf("sustained: %zu DAQs (%zu channels)\n", sustained, sustained * 4);
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Write throughput of the BinaryFile backends.
+// Usage: file_backends [data_folder=./file_backends_data] [max_mb=1024]
+// Writes files of 1 MB, 4 MB, ... max_mb through save_channel with the ofstream backend, the POSIX backend, the
+// POSIX backend with preallocation and the mmap backend, then as version 4 files through the POSIX backend, plain,
+// cut into 64 Ki-sample chunks with a CRC-32C each, and stored as int16, repeating each size until about 1 GB has been written (at least
+// three times), and reports the median MB/s. Nothing is fsynced, so this measures the path into the page cache.
+// Also prints the CRC-32C throughput on its own, to compare with what it costs a file.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "save_signal.hpp"
+#include "crc32c.hpp"
+
+namespace {
+
+// GB/s of checksumming a 1 MiB buffer, best of a few rounds
+double crc_rate(uint32_t (*crc)(uint32_t, const void*, size_t)) {
+    std::vector<unsigned char> buffer(size_t(1) << 20);
+    for (size_t i = 0; i < buffer.size(); i++) {
+        buffer[i] = (unsigned char)(i * 131);
+    }
+    double best = 0;
+    volatile uint32_t sink = 0;
+    for (int round = 0; round < 5; round++) {
+        const auto start = std::chrono::steady_clock::now();
+        uint32_t c = 0;
+        for (int i = 0; i < 64; i++) {
+            c = crc(c, buffer.data(), buffer.size());
+        }
+        sink = c;
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, 64.0 * double(buffer.size()) / 1e9 / seconds);
+    }
+    (void)sink;
+    return best;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string folder = argc > 1 ? argv[1] : "./file_backends_data";
+    const size_t max_mb = argc > 2 ? size_t(atoi(argv[2])) : 1024;
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+
+    struct variant {
+        const char* name;
+        file_options options;
+    };
+    printf("crc32c: %.1f GB/s (%s), %.1f GB/s (table)\n", crc_rate(crc32c), crc32c_implementation(), crc_rate(crc32c_portable));
+
+    std::vector<variant> variants(7);
+    variants[0].name = "ofstream";
+    variants[0].options.backend = file_backend_kind::stream;
+    variants[1].name = "posix";
+    variants[1].options.backend = file_backend_kind::posix;
+    variants[2].name = "posix+prealloc";
+    variants[2].options.backend = file_backend_kind::posix;
+    variants[2].options.preallocate = true;
+    variants[3].name = "mmap";
+    variants[3].options.backend = file_backend_kind::mmap;
+    variants[4].name = "v4";
+    variants[4].options.version = 4;
+    variants[5].name = "v4+crc";
+    variants[5].options.version = 4;
+    variants[5].options.chunk_frames = size_t(1) << 16;
+    variants[6].name = "v4 int16";
+    variants[6].options.version = 4;
+    variants[6].options.encoding = sample_encoding::int16;
+
+    printf("    size MB");
+    for (const auto& v : variants) {
+        printf("  %14s MB/s", v.name);
+    }
+    printf("\n");
+    // Names have one-second resolution and never replace a file; each file gets a second of its own
+    time_t acquired = time(0);
+    for (size_t mb = 1; mb <= max_mb; mb *= 4) {
+        std::vector<double> y(mb * (size_t(1) << 20) / sizeof(double));
+        for (size_t i = 0; i < y.size(); i++) {
+            y[i] = double(i);
+        }
+        ACQCONFIG config = single_channel_config(20000, 1, 1, 0, 1, 1);
+        const size_t repeats = std::max<size_t>(3, 1024 / mb);
+        printf("%11zu", mb);
+        for (const auto& v : variants) {
+            std::vector<double> rates;
+            for (size_t r = 0; r < repeats; r++) {
+                const auto start = std::chrono::steady_clock::now();
+                if (save_channel(folder, config, 0, y, v.options, nullptr, acquired++) != 0) {
+                    fprintf(stderr, "write failed\n");
+                    return 1;
+                }
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                rates.push_back(double(mb) * (1 << 20) / 1e6 / seconds);
+            }
+            std::sort(rates.begin(), rates.end());
+            printf("  %19.0f", rates[rates.size() / 2]);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    std::filesystem::remove_all(folder, ec);
+    return 0;
+}
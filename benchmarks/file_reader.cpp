@@ -0,0 +1,114 @@
+// Verification sweep with BinaryFileReader.
+// Usage: file_reader [data_folder=./file_reader_data] [files=2000] [samples=10000]
+// Writes one file of samples per channel in each format (version 3, one channel; version 4, four channels; version 4
+// chunked by 4096 samples; version 4 stored as int16, which the reader decodes at open; the same compressed, which
+// it decompresses at open), copies it files times,
+// then opens and validates every copy, first checking the header, trailer and chunk index only, then also touching
+// every sample (summing them, or checking the chunk CRCs). Reports files/s and GB/s for each; the copies are in the page cache, so this measures the reader.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "binary_file.hpp"
+#include "binary_file_reader.hpp"
+
+int main(int argc, char** argv) {
+    const std::string folder = argc > 1 ? argv[1] : "./file_reader_data";
+    const size_t files = argc > 2 ? size_t(atoi(argv[2])) : 2000;
+    const size_t samples = argc > 3 ? size_t(atoi(argv[3])) : 10000;
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+
+    ACQCONFIG config;
+    config.daq_serial_number = 1;
+    config.sampling_freq = int(samples);
+    config.acq_duration = 1;
+    config.acq_interval = 1;
+    for (int c = 0; c < 4; c++) {
+        config.channels[c].status = 1;
+        config.channels[c].sensor_type = 1;
+        config.channels[c].sensitivity = 1;
+    }
+    std::vector<double> y(samples * 4);
+    for (size_t i = 0; i < y.size(); i++) {
+        y[i] = double(i % 1000) * 0.001;
+    }
+
+    struct variant {
+        const char* name;
+        file_options options;
+    };
+    std::vector<variant> variants(5);
+    variants[0].name = "v3";
+    variants[1].name = "v4";
+    variants[1].options.version = 4;
+    variants[2].name = "v4 chunked";
+    variants[2].options.version = 4;
+    variants[2].options.chunk_frames = 4096;
+    variants[3].name = "v4 int16";
+    variants[3].options.version = 4;
+    variants[3].options.encoding = sample_encoding::int16;
+    variants[4].name = "v4 int16 z";
+    variants[4].options.version = 4;
+    variants[4].options.encoding = sample_encoding::int16;
+    variants[4].options.compress = true;
+
+    printf("%zu files of %zu samples per channel\n", files, samples);
+    printf("  format           open+check files/s    full pass files/s    full pass GB/s\n");
+    for (const auto& v : variants) {
+        const std::string dir = folder + "/" + std::to_string(&v - variants.data());
+        std::filesystem::create_directories(dir, ec);
+        std::string original;
+        {
+            BinaryFile file = v.options.version == 4 ? BinaryFile(dir, config, v.options) : BinaryFile(dir, config, 0, v.options);
+            if (file.writeAll(v.options.version == 4 ? y : std::vector<double>(y.begin(), y.begin() + ptrdiff_t(samples))) != 0) {
+                fprintf(stderr, "write failed\n");
+                return 1;
+            }
+            original = file.file_name_location;
+        }
+        std::vector<std::string> paths(files);
+        for (size_t i = 0; i < files; i++) {
+            paths[i] = dir + "/copy" + std::to_string(i) + ".bin";
+            std::filesystem::copy_file(original, paths[i], std::filesystem::copy_options::overwrite_existing, ec);
+        }
+        const uint64_t file_bytes = std::filesystem::file_size(original, ec);
+
+        double rates[2];
+        for (int pass = 0; pass < 2; pass++) {
+            BinaryFileReader reader;
+            double sink = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (const std::string& path : paths) {
+                if (!reader.open(path)) {
+                    fprintf(stderr, "%s\n", reader.error().c_str());
+                    return 1;
+                }
+                if (pass == 1) {
+                    if (reader.chunkCount() > 0) {
+                        if (!reader.verifyChunks()) {
+                            fprintf(stderr, "%s: chunk checksum mismatch\n", path.c_str());
+                            return 1;
+                        }
+                    }
+                    else {
+                        for (double x : reader.data()) {
+                            sink += x;
+                        }
+                    }
+                }
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            rates[pass] = double(files) / seconds;
+            if (sink < 0) {
+                printf("%f\n", sink);  // keeps the sum
+            }
+        }
+        printf("  %-10s %23.0f %20.0f %17.2f\n", v.name, rates[0], rates[1], rates[1] * double(file_bytes) / 1e9);
+    }
+    std::filesystem::remove_all(folder, ec);
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Scaling of chunked generation with thread count.
+// Usage: generation_scaling [seconds=60] [sampling_freq=200000] [max_threads=hardware_concurrency]
+// Mixes a long acquisition (4 sines, a pulse train and white noise) on pools of 1..max_threads threads,
+// reports throughput and speedup, and checks that every thread count gives the same samples bit for bit.
+// Built by the top-level CMakeLists.txt (target generation_scaling)
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "signal.hpp"
+#include "signal_mixer.hpp"
+#include "thread_pool.hpp"
+
+int main(int argc, char** argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 60.0;
+    const int sampling_freq = argc > 2 ? atoi(argv[2]) : 200000;
+    const size_t max_threads = argc > 3 ? size_t(atoi(argv[3])) : std::max(1u, std::thread::hardware_concurrency());
+    const size_t samples = size_t(seconds * sampling_freq);
+
+    std::vector<std::unique_ptr<signal>> signals;
+    signals.push_back(std::make_unique<sin_signal>(50.0f, 0.0f, 1.0f));
+    signals.push_back(std::make_unique<sin_signal>(120.0f, 0.5f, 0.3f));
+    signals.push_back(std::make_unique<sin_signal>(1375.0f, 1.0f, 0.1f));
+    signals.push_back(std::make_unique<sin_signal>(4400.0f, 0.2f, 0.05f));
+    signals.push_back(std::make_unique<pulse_train>(25.0f, 0.05f, 1.0f));
+    signals.push_back(std::make_unique<white_signal>(0.2f, 1u));
+
+    sample_block block;
+    block.sampling_freq = sampling_freq;
+
+    printf("%zu samples x %zu components, kernels: %s\n", samples, signals.size(), simd_level_name(detected_simd_level()));
+    printf("threads  best ms  Msamples/s  speedup  identical\n");
+    std::vector<double> reference;
+    double base_ms = 0;
+    for (size_t threads = 1; threads <= max_threads; threads++) {
+        thread_pool pool(threads);
+        double best_ms = 1e300;
+        signal_mixer mixer;
+        for (int run = 0; run < 5; run++) {
+            for (auto& sig : signals) {
+                sig->touch();
+            }
+            const auto start = std::chrono::steady_clock::now();
+            mixer.mix(block, samples, signals, &pool);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best_ms = std::min(best_ms, elapsed.count());
+        }
+        if (threads == 1) {
+            reference = mixer.sum;
+            base_ms = best_ms;
+        }
+        const bool identical = memcmp(reference.data(), mixer.sum.data(), samples * sizeof(double)) == 0;
+        printf("%7zu  %7.1f  %10.1f  %7.2f  %s\n", threads, best_ms, samples / best_ms / 1e3, base_ms / best_ms, identical ? "yes" : "NO");
+        if (!identical) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Sustained multi-stream recording through the BinaryFile backends.
+// Usage: stream_writes [data_folder=./stream_writes_data] [seconds=10] [file_mb=4] [fsync=none|file|group]
+// For 1, 16 and 64 concurrent streams, each stream a thread writing file_mb files back to back through
+// BinaryFile::writeAll for the given time, reports the sustained MB/s over all streams and the p50/p99/max time
+// to write one file, for the buffered posix backend and the O_DIRECT backend (io_uring, or pwrite without it).
+// Files are kept until the end of each run, so the page cache fills up as it would while recording. fsync is how
+// each file is made durable before it is renamed from .temp to .bin; with group, the files per group commit are
+// reported at the end.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "binary_file.hpp"
+#include "save_signal.hpp"
+#include "direct_io.hpp"
+#include "file_publish.hpp"
+
+int main(int argc, char** argv) {
+    const std::string folder = argc > 1 ? argv[1] : "./stream_writes_data";
+    const double seconds = argc > 2 ? atof(argv[2]) : 10.0;
+    const size_t file_mb = argc > 3 ? size_t(atoi(argv[3])) : 4;
+    fsync_policy fsync = fsync_policy::none;
+    if (argc > 4 && !parse_fsync_policy(argv[4], fsync)) {
+        fprintf(stderr, "unknown fsync policy %s\n", argv[4]);
+        return 1;
+    }
+    const std::vector<double> y(file_mb * (size_t(1) << 20) / sizeof(double), 1.0);
+    const ACQCONFIG config = single_channel_config(20000, 1, 1, 0, 1, 1);
+
+#ifdef __linux__
+    printf("%zu MB files for %.0f s per run, direct backend uses %s\n", file_mb, seconds,
+        direct_io_ring::shared().available() ? "io_uring" : "pwrite");
+#endif
+    printf("  streams  backend      MB/s    p50 ms    p99 ms    max ms\n");
+    for (size_t streams : { size_t(1), size_t(16), size_t(64) }) {
+        for (file_backend_kind backend : { file_backend_kind::posix, file_backend_kind::direct }) {
+            file_options options;
+            options.backend = backend;
+            options.preallocate = true;
+            options.fsync = fsync;
+            std::mutex mutex;
+            std::vector<double> latencies;
+            std::atomic<uint64_t> bytes{ 0 };
+            bool failed = false;
+            const auto start = std::chrono::steady_clock::now();
+            const auto end = start + std::chrono::duration<double>(seconds);
+            std::vector<std::thread> threads;
+            for (size_t s = 0; s < streams; s++) {
+                threads.emplace_back([&, s] {
+                    const std::filesystem::path dir = std::filesystem::path(folder) / std::to_string(s);
+                    std::error_code ec;
+                    std::filesystem::create_directories(dir, ec);
+                    std::vector<double> mine;
+                    for (size_t n = 0; std::chrono::steady_clock::now() < end; n++) {
+                        ACQCONFIG c = config;
+                        const auto t = std::chrono::steady_clock::now();
+                        BinaryFile file(dir.string(), c, 0, options);
+                        const bool ok = file.writeAll(y) == 0;
+                        mine.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count());
+                        if (!ok) {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            failed = true;
+                            break;
+                        }
+                        bytes += sizeof(FileHeader) + y.size() * sizeof(double) + sizeof(FileTrailer);
+                        // File names have one-second resolution; keep every file
+                        std::filesystem::rename(file.file_name_location, dir / (std::to_string(n) + ".bin"), ec);
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    latencies.insert(latencies.end(), mine.begin(), mine.end());
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::sort(latencies.begin(), latencies.end());
+            auto quantile = [&latencies](double q) {
+                return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, size_t(q * double(latencies.size())))];
+            };
+            printf("%9zu  %-7s  %8.0f  %8.1f  %8.1f  %8.1f%s\n", streams, file_backend_name(backend),
+                double(bytes) / elapsed / 1e6, quantile(0.5), quantile(0.99), latencies.empty() ? 0.0 : latencies.back(),
+                failed ? "  (write failed)" : "");
+            fflush(stdout);
+            std::error_code ec;
+            std::filesystem::remove_all(folder, ec);
+        }
+    }
+    if (fsync == fsync_policy::group) {
+        const group_commit::statistics commits = group_commit::shared().stats();
+        printf("%llu files in %llu group commits\n", (unsigned long long)commits.files, (unsigned long long)commits.batches);
+    }
+    return 0;
+}
@@ -0,0 +1,335 @@
+// Writes PDAT files in every combination BinaryFile supports and reads them back with BinaryFileReader.
+// Usage: file_round_trip [data_folder=./file_round_trip_data]
+// Then forges the chunk index of a compressed file, which the reader must reject rather than crash on or
+// allocate for. Version 3 (one channel) and version 4 (three channels of different sensitivities, planar and interleaved,
+// whole or in chunks, compressed or not), in each sample encoding, through each backend, written with
+// writeAcquisition() or with insertData() in uneven pieces, with and without a thread_pool for writing and
+// opening. Every file must open, pass verifyChunks() and give back its samples: float64 exactly, float32 as the
+// nearest float, integer encodings within half a count. Exits with 1 on the first mismatch.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "binary_file.hpp"
+#include "binary_file_reader.hpp"
+#include "crc32c.hpp"
+#include "sample_encoding.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+const size_t samples = 5003;  // per channel; leaves a short last chunk whatever the chunk size
+const int sensitivities[3] = { 1, 2, 5 };
+
+struct test_case {
+    int version;
+    int channels;
+    sample_layout layout;
+    size_t chunk_frames;
+    sample_encoding encoding;
+    bool compress;
+    file_backend_kind backend;
+    bool insert;
+    bool pool;
+};
+
+std::string describe(const test_case& t) {
+    return "v" + std::to_string(t.version) + " " + std::to_string(t.channels) + " channels "
+        + (t.layout == sample_layout::planar ? "planar" : "interleaved") + " chunk " + std::to_string(t.chunk_frames) + " "
+        + sample_encoding_name(t.encoding) + (t.compress ? " compressed " : " ") + file_backend_name(t.backend)
+        + (t.insert ? " insertData" : " writeAcquisition") + (t.pool ? " pool" : "");
+}
+
+// Samples per channel in each chunk the file will have; the whole acquisition when it is not chunked
+size_t chunk_of(const test_case& t) {
+    if (t.chunk_frames != 0) {
+        return t.chunk_frames;
+    }
+    return t.compress ? 16384 : samples;
+}
+
+// The planar acquisition in the order insertData() takes it: chunk after chunk, each in the file's layout
+std::vector<double> file_order(const test_case& t, const std::vector<double>& planar) {
+    std::vector<double> values;
+    const size_t chunk = chunk_of(t);
+    for (size_t first = 0; first < samples; first += chunk) {
+        const size_t frames = std::min(chunk, samples - first);
+        if (t.layout == sample_layout::interleaved) {
+            for (size_t i = 0; i < frames; i++) {
+                for (int c = 0; c < t.channels; c++) {
+                    values.push_back(planar[size_t(c) * samples + first + i]);
+                }
+            }
+        }
+        else {
+            for (int c = 0; c < t.channels; c++) {
+                values.insert(values.end(), planar.begin() + ptrdiff_t(size_t(c) * samples + first),
+                    planar.begin() + ptrdiff_t(size_t(c) * samples + first + frames));
+            }
+        }
+    }
+    return values;
+}
+
+bool close_enough(sample_encoding encoding, int sensitivity, double got, double want) {
+    switch (encoding) {
+    case sample_encoding::float64:
+        return got == want;
+    case sample_encoding::float32:
+        return got == double(float(want));
+    default:
+        // Half a count, with room for the scale being stored as a float
+        return std::abs(got - want) <= encoding_scale(encoding, 10, sensitivity) * 0.5 * (1 + 1e-6);
+    }
+}
+
+// Empty when the file reads back as written, what is wrong otherwise
+std::string check(const test_case& t, const std::string& path, const std::vector<double>& planar, thread_pool* pool) {
+    BinaryFileReader reader;
+    if (!reader.open(path, pool)) {
+        return "open: " + reader.error();
+    }
+    if (reader.version() != t.version || reader.channelCount() != t.channels || reader.samples() != samples
+        || reader.encoding() != t.encoding || (reader.codec() != sample_codec::none) != t.compress) {
+        return "header does not match what was written";
+    }
+    if (!reader.verifyChunks()) {
+        return "chunk CRC mismatch";
+    }
+    const bool interleaved = t.version == 4 && t.layout == sample_layout::interleaved;
+    const size_t chunks = std::max<size_t>(reader.chunkCount(), 1);
+    size_t first = 0;
+    for (size_t k = 0; k < chunks; k++) {
+        const std::span<const double> data = reader.chunkCount() != 0 ? reader.chunkData(k) : reader.data();
+        const size_t frames = data.size() / size_t(t.channels);
+        for (int c = 0; c < t.channels; c++) {
+            for (size_t i = 0; i < frames; i++) {
+                const double got = interleaved ? data[i * size_t(t.channels) + size_t(c)] : data[size_t(c) * frames + i];
+                const double want = planar[size_t(c) * samples + first + i];
+                if (!close_enough(t.encoding, sensitivities[c], got, want)) {
+                    return "channel " + std::to_string(c) + " sample " + std::to_string(first + i) + ": read "
+                        + std::to_string(got) + ", wrote " + std::to_string(want);
+                }
+            }
+        }
+        first += frames;
+    }
+    return first == samples ? "" : "chunks hold " + std::to_string(first) + " samples per channel";
+}
+
+std::vector<unsigned char> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Empty when BinaryFileReader refuses bytes written to path, what is wrong otherwise
+std::string rejected(const std::string& path, const std::vector<unsigned char>& bytes) {
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    }
+    BinaryFileReader reader;
+    if (reader.open(path)) {
+        return "a forged file was accepted";
+    }
+    return "";
+}
+
+// A compressed file whose footer, then whose chunk frame counts, have been forged
+std::string check_forged_index(const std::string& folder, ACQCONFIG& config, const std::vector<double>& planar, time_t acquired) {
+    file_options options;
+    options.version = 4;
+    options.encoding = sample_encoding::int16;
+    options.compress = true;
+    options.chunk_frames = 1000;
+    std::string path;
+    {
+        BinaryFile file(folder, config, options, acquired);
+        path = file.file_name_location;
+        if (file.writeAcquisition(planar.data(), samples) != 0) {
+            return "writeAcquisition failed";
+        }
+    }
+    const std::vector<unsigned char> original = read_file(path);
+    const size_t footer_at = original.size() - sizeof(FileTrailer) - sizeof(ChunkFooter);
+    ChunkFooter footer;
+    memcpy(&footer, original.data() + footer_at, sizeof(footer));
+
+    // A chunk count whose index size wraps index_offset + index size around to the file size
+    std::vector<unsigned char> bytes = original;
+    ChunkFooter wrapped = footer;
+    wrapped.chunk_count = 0xFFFFFFFFu;
+    wrapped.index_offset = uint64_t(original.size()) - (uint64_t(wrapped.chunk_count) * sizeof(ChunkEntry) + sizeof(ChunkFooter) + sizeof(FileTrailer));
+    memcpy(bytes.data() + footer_at, &wrapped, sizeof(wrapped));
+    std::string problem = rejected(folder + "/wrapped_index.bin", bytes);
+    if (!problem.empty()) {
+        return "wrapped chunk index: " + problem;
+    }
+
+    // Frame counts no compressed chunk of that size could hold, with the header, trailer and index checksum to
+    // match, so only the chunk sizes give them away
+    bytes = original;
+    FileHeaderV4 header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    header.chunk_frames = 0x7FFFFFFF;
+    memcpy(bytes.data(), &header, sizeof(header));
+    std::vector<ChunkEntry> entries(footer.chunk_count);
+    memcpy(entries.data(), bytes.data() + footer.index_offset, entries.size() * sizeof(ChunkEntry));
+    FileTrailer trailer = { 0 };
+    for (ChunkEntry& entry : entries) {
+        entry.frames = 0x10000000u;
+        trailer.recordCount += entry.frames;  // 1.6 billion per channel, 38 GB of doubles
+    }
+    memcpy(bytes.data() + footer.index_offset, entries.data(), entries.size() * sizeof(ChunkEntry));
+    footer.index_crc = crc32c(0, entries.data(), entries.size() * sizeof(ChunkEntry));
+    memcpy(bytes.data() + footer_at, &footer, sizeof(footer));
+    memcpy(bytes.data() + bytes.size() - sizeof(trailer), &trailer, sizeof(trailer));
+    problem = rejected(folder + "/forged_frames.bin", bytes);
+    if (!problem.empty()) {
+        return "forged frame counts: " + problem;
+    }
+    return "";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string folder = argc > 1 ? argv[1] : "./file_round_trip_data";
+    std::error_code ec;
+    std::filesystem::remove_all(folder, ec);
+    std::filesystem::create_directories(folder, ec);
+    thread_pool pool(3);
+
+    std::vector<test_case> cases;
+    for (int version : { 3, 4 }) {
+        for (int l = 0; l < 2; l++) {
+            for (size_t chunk_frames : { size_t(0), size_t(1000) }) {
+                for (int compress = 0; compress < 2; compress++) {
+                    // Version 3 files hold one channel, whole and uncompressed
+                    if (version == 3 && (l != 0 || chunk_frames != 0 || compress)) {
+                        continue;
+                    }
+                    for (int e = int(sample_encoding::float64); e <= int(sample_encoding::int24); e++) {
+                        for (file_backend_kind backend : { file_backend_kind::stream, file_backend_kind::posix, file_backend_kind::mmap, file_backend_kind::direct }) {
+                            for (int insert = 0; insert < 2; insert++) {
+                                for (int with_pool = 0; with_pool < 2; with_pool++) {
+                                    cases.push_back({ version, version == 3 ? 1 : 3, sample_layout(l), chunk_frames, sample_encoding(e),
+                                        compress != 0, backend, insert != 0, with_pool != 0 });
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Every file is named after a second of its own
+    time_t acquired = time(0);
+    for (const test_case& t : cases) {
+        ACQCONFIG config;
+        config.daq_serial_number = 1;
+        config.sampling_freq = 1000;
+        config.acq_duration = 5;
+        config.acq_interval = 5;
+        for (int c = 0; c < t.channels; c++) {
+            config.channels[c].status = 1;
+            config.channels[c].sensor_type = 1;
+            config.channels[c].sensitivity = sensitivities[c];
+        }
+        // A shaft harmonic and a step on each channel, within full scale for its sensitivity
+        std::vector<double> planar(samples * size_t(t.channels));
+        for (int c = 0; c < t.channels; c++) {
+            for (size_t i = 0; i < samples; i++) {
+                planar[size_t(c) * samples + i] = (2 * std::sin(0.01 * double(i) * (c + 1)) + ((i / 300) % 2 ? 0.5 : 0)) / sensitivities[c];
+            }
+        }
+        file_options options;
+        options.version = t.version;
+        options.layout = t.layout;
+        options.chunk_frames = t.chunk_frames;
+        options.encoding = t.encoding;
+        options.compress = t.compress;
+        options.backend = t.backend;
+        thread_pool* p = t.pool ? &pool : nullptr;
+
+        std::string path;
+        {
+            BinaryFile file = t.version == 4 ? BinaryFile(folder, config, options, acquired++) : BinaryFile(folder, config, 0, options, acquired++);
+            path = file.file_name_location;
+            if (t.insert) {
+                const std::vector<double> values = file_order(t, planar);
+                // Planar integer samples of several channels cannot be told apart value by value
+                const bool refused = t.channels > 1 && t.layout == sample_layout::planar
+                    && (t.encoding == sample_encoding::int16 || t.encoding == sample_encoding::int24);
+                size_t at = 0;
+                for (size_t piece = 1; at < values.size(); piece++) {
+                    const size_t n = std::min(values.size() - at, size_t(t.channels) * (piece * 397 % 1500 + 1));
+                    const int result = file.insertData(std::vector<double>(values.begin() + ptrdiff_t(at), values.begin() + ptrdiff_t(at + n)));
+                    if (refused) {
+                        if (result == 0) {
+                            printf("FAIL %s: planar integer insertData was accepted\n", describe(t).c_str());
+                            return 1;
+                        }
+                        break;
+                    }
+                    if (result != 0) {
+                        printf("FAIL %s: insertData failed\n", describe(t).c_str());
+                        return 1;
+                    }
+                    at += n;
+                }
+                if (refused) {
+                    continue;
+                }
+                if (file.close() != 0) {
+                    printf("FAIL %s: close failed\n", describe(t).c_str());
+                    return 1;
+                }
+            }
+            else if (file.writeAcquisition(planar.data(), samples, p) != 0) {
+                printf("FAIL %s: writeAcquisition failed\n", describe(t).c_str());
+                return 1;
+            }
+        }
+        const std::string problem = check(t, path, planar, p);
+        if (!problem.empty()) {
+            printf("FAIL %s: %s\n", describe(t).c_str(), problem.c_str());
+            return 1;
+        }
+    }
+    {
+        ACQCONFIG config;
+        config.daq_serial_number = 1;
+        config.sampling_freq = 1000;
+        for (int c = 0; c < 3; c++) {
+            config.channels[c].status = 1;
+            config.channels[c].sensor_type = 1;
+            config.channels[c].sensitivity = sensitivities[c];
+        }
+        std::vector<double> planar(samples * 3);
+        for (size_t i = 0; i < planar.size(); i++) {
+            planar[i] = std::sin(0.003 * double(i));
+        }
+        const std::string problem = check_forged_index(folder, config, planar, acquired++);
+        if (!problem.empty()) {
+            printf("FAIL %s\n", problem.c_str());
+            return 1;
+        }
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(folder, ec)) {
+        if (entry.path().extension() != ".bin") {
+            printf("FAIL: %s left behind\n", entry.path().string().c_str());
+            return 1;
+        }
+    }
+    printf("%zu combinations written and read back\n", cases.size());
+    std::filesystem::remove_all(folder, ec);
+    return 0;
+}